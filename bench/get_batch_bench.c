@@ -0,0 +1,81 @@
+/* Compares hashtable_get_batch against a loop of hashtable_get, on a hashtable
+ * much larger than the last-level cache so that most lookups miss it.
+ *
+ * Build from the repository root, with the crash_test/err sources:
+ *     cc -O2 -pthread -Ihashtable bench/get_batch_bench.c \
+ *         $(find hashtable -name '*.c') <crash_test/err sources> -o get_batch_bench
+ *
+ * Usage: get_batch_bench [entries] [lookups]
+ * The defaults are 8M entries (several hundred MB of nodes and keys, far beyond
+ * any LLC) and 8M lookups of random present keys.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hashtable.h"
+
+#define BENCH_BATCH 256
+
+double _bench_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+uint64_t _bench_next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+int main(int argc, char **argv) {
+    uint32_t entries = argc > 1 ? (uint32_t) strtoul(argv[1], NULL, 10) : 8u << 20;
+    uint32_t lookups = argc > 2 ? (uint32_t) strtoul(argv[2], NULL, 10) : 8u << 20;
+
+    char **keys = malloc(entries * sizeof(char *));
+    for (uint32_t i = 0; i < entries; i++) {
+        keys[i] = malloc(24);
+        snprintf(keys[i], 24, "key:%u", i);
+    }
+
+    hashtable *table = hashtable_build(keys, (void **) keys, entries, 1);
+
+    // Look up in a random order, so that consecutive lookups share no lines
+    char **order = malloc(lookups * sizeof(char *));
+    uint64_t state = 88172645463325252ULL;
+    for (uint32_t i = 0; i < lookups; i++) {
+        order[i] = keys[_bench_next_random(&state) % entries];
+    }
+
+    uint32_t found = 0;
+    double begin = _bench_now();
+    for (uint32_t i = 0; i < lookups; i++) {
+        if (hashtable_get(table, order[i])) found++;
+    }
+    double get_time = _bench_now() - begin;
+
+    void *vals[BENCH_BATCH];
+    uint32_t batch_found = 0;
+    begin = _bench_now();
+    for (uint32_t i = 0; i < lookups; i += BENCH_BATCH) {
+        uint32_t n = lookups - i < BENCH_BATCH ? lookups - i : BENCH_BATCH;
+        batch_found += hashtable_get_batch(table, order + i, vals, n);
+    }
+    double batch_time = _bench_now() - begin;
+
+    printf("entries %u, lookups %u\n", entries, lookups);
+    printf("hashtable_get       %7.1f ns/lookup (found %u)\n", get_time * 1e9 / lookups, found);
+    printf("hashtable_get_batch %7.1f ns/lookup (found %u)\n", batch_time * 1e9 / lookups, batch_found);
+    printf("speedup             %7.2fx\n", get_time / batch_time);
+
+    hashtable_destroy(table);
+    for (uint32_t i = 0; i < entries; i++) free(keys[i]);
+    free(keys);
+    free(order);
+
+    return 0;
+}
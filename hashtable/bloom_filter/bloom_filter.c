@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bloom_filter.h"
+#include "../../crash_test/err/err.h"
+
+// Odd constants used to derive one bit position per word from a single hash.
+// These are the salts of the split block bloom filter used by Parquet.
+static const uint32_t BLOOM_FILTER_SALTS[BLOOM_FILTER_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+// Spreads the bits of a (possibly weak) string hash over all 64 bits
+uint64_t _bloom_filter_mix(unsigned long hash) {
+    uint64_t h = hash;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+bloom_filter_block *_bloom_filter_get_block(bloom_filter *filter, uint64_t mixed) {
+    // Maps the upper 32 bits onto [0, block_count) without a division
+    uint64_t index = ((mixed >> 32) * filter->block_count) >> 32;
+    return filter->blocks + index;
+}
+
+void _bloom_filter_get_mask(uint64_t mixed, uint64_t mask[BLOOM_FILTER_BLOCK_WORDS]) {
+    uint32_t key = (uint32_t) mixed;
+
+    for (int i = 0; i < BLOOM_FILTER_BLOCK_WORDS; i++) {
+        mask[i] = 1ULL << ((key * BLOOM_FILTER_SALTS[i]) >> 26);
+    }
+}
+
+bloom_filter *bloom_filter_init(uint32_t expected_items, uint8_t bits_per_item) {
+    if (bits_per_item == 0) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to initialize a bloom_filter with zero bits per item", "Returning null");
+        return NULL;
+    }
+
+    uint64_t block_bits = sizeof(bloom_filter_block) * 8;
+    uint64_t block_count = ((uint64_t) expected_items * bits_per_item + block_bits - 1) / block_bits;
+
+    if (block_count == 0) block_count = 1;
+    if (block_count > UINT32_MAX) block_count = UINT32_MAX;
+
+    bloom_filter *filter = malloc(sizeof(bloom_filter));
+
+    filter->block_count = (uint32_t) block_count;
+    filter->bits_per_item = bits_per_item;
+    filter->blocks = aligned_alloc(sizeof(bloom_filter_block), block_count * sizeof(bloom_filter_block));
+    filter->queries = 0;
+    filter->positives = 0;
+    filter->false_positives = 0;
+
+    bloom_filter_clear(filter);
+
+    return filter;
+}
+
+void bloom_filter_destroy(bloom_filter *filter) {
+    if (!filter) return;
+
+    free(filter->blocks);
+    free(filter);
+}
+
+void bloom_filter_clear(bloom_filter *filter) {
+    if (!filter) return;
+
+    memset(filter->blocks, 0, (size_t) filter->block_count * sizeof(bloom_filter_block));
+}
+
+void bloom_filter_add(bloom_filter *filter, unsigned long hash) {
+    if (!filter) return;
+
+    uint64_t mixed = _bloom_filter_mix(hash);
+    bloom_filter_block *block = _bloom_filter_get_block(filter, mixed);
+
+    uint64_t mask[BLOOM_FILTER_BLOCK_WORDS];
+    _bloom_filter_get_mask(mixed, mask);
+
+    for (int i = 0; i < BLOOM_FILTER_BLOCK_WORDS; i++) {
+        block->words[i] |= mask[i];
+    }
+}
+
+bool bloom_filter_might_contain(bloom_filter *filter, unsigned long hash) {
+    // Without a filter we can't rule anything out
+    if (!filter) return true;
+
+    uint64_t mixed = _bloom_filter_mix(hash);
+    bloom_filter_block *block = _bloom_filter_get_block(filter, mixed);
+
+    uint64_t mask[BLOOM_FILTER_BLOCK_WORDS];
+    _bloom_filter_get_mask(mixed, mask);
+
+    // Branch-free across the whole block so that the compiler can check all 
+    // the words at once with SIMD instructions
+    uint64_t missing = 0;
+    for (int i = 0; i < BLOOM_FILTER_BLOCK_WORDS; i++) {
+        missing |= mask[i] & ~block->words[i];
+    }
+
+    filter->queries++;
+    if (missing) return false;
+
+    filter->positives++;
+    return true;
+}
+
+void bloom_filter_record_false_positive(bloom_filter *filter) {
+    if (!filter) return;
+    filter->false_positives++;
+}
+
+double bloom_filter_get_false_positive_rate(bloom_filter *filter) {
+    if (!filter) return 0;
+
+    // Queries for absent items are the true negatives plus the false positives
+    uint64_t absent = filter->queries - filter->positives + filter->false_positives;
+    if (absent == 0) return 0;
+
+    return (double) filter->false_positives / absent;
+}
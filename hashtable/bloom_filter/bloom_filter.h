@@ -0,0 +1,62 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <stdbool.h>
+
+#include "bloom_filter_struct.h"
+
+/* Creates an empty bloom_filter sized for the expected number of items
+ *
+ * @param expected_items The number of items the filter is expected to hold
+ * @param bits_per_item  The number of bits of filter to allocate per item. 
+ *                       Higher values give a lower false-positive rate.
+ * @return               A pointer to the newly created bloom_filter, or NULL if
+ *                       bits_per_item is zero
+ */
+bloom_filter *bloom_filter_init(uint32_t expected_items, uint8_t bits_per_item);
+
+/* Frees all memory occupied by a bloom_filter
+ *
+ * @param filter The bloom_filter to destroy
+ */
+void bloom_filter_destroy(bloom_filter *filter);
+
+/* Unsets every bit in a bloom_filter, leaving its size and counters unchanged
+ *
+ * @param filter The bloom_filter to clear
+ */
+void bloom_filter_clear(bloom_filter *filter);
+
+/* Adds the hash of an item to a bloom_filter
+ *
+ * @param filter The bloom_filter to add the hash to
+ * @param hash   The hash of the item being added
+ */
+void bloom_filter_add(bloom_filter *filter, unsigned long hash);
+
+/* Returns false iff the item with the given hash is definitely not in the 
+ * bloom_filter. Only touches the one block (cache line) the hash maps to.
+ *
+ * @param filter The bloom_filter to perform the check on
+ * @param hash   The hash of the item to check for
+ * @return       False iff the item is definitely absent, else true
+ */
+bool bloom_filter_might_contain(bloom_filter *filter, unsigned long hash);
+
+/* Records that a positive answer from bloom_filter_might_contain turned out to 
+ * be for an absent item
+ *
+ * @param filter The bloom_filter which gave the false positive
+ */
+void bloom_filter_record_false_positive(bloom_filter *filter);
+
+/* Returns the fraction of queries for absent items which the bloom_filter 
+ * failed to rule out
+ *
+ * @param filter The bloom_filter to get the false-positive rate of
+ * @return       The observed false-positive rate, or 0 if no absent items have
+ *               been queried
+ */
+double bloom_filter_get_false_positive_rate(bloom_filter *filter);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef BLOOM_FILTER_STRUCT_H
+#define BLOOM_FILTER_STRUCT_H
+
+#include <stdint.h>
+
+// The number of 64-bit words in a block. A block is one 64-byte cache line, and
+// each item sets exactly one bit in each word of its block.
+#define BLOOM_FILTER_BLOCK_WORDS 8
+
+/* A single cache line of a blocked bloom_filter
+ *
+ * @elem words The bits of the block, one of which is set per item per word
+ */
+typedef struct bloom_filter_block {
+    uint64_t words[BLOOM_FILTER_BLOCK_WORDS];
+} __attribute__((aligned(64))) bloom_filter_block;
+
+/* A struct storing a blocked bloom filter over hash values, together with the
+ * counters needed to estimate its false-positive rate
+ *
+ * @elem blocks          The cache-line-sized blocks making up the filter
+ * @elem block_count     The number of blocks in the filter
+ * @elem bits_per_item   The number of bits the filter was sized with per item
+ * @elem queries         The number of times the filter has been consulted
+ * @elem positives       The number of queries which the filter did not rule out
+ * @elem false_positives The number of positives which turned out to be absent
+ */
+typedef struct bloom_filter {
+    bloom_filter_block *blocks;
+    uint32_t block_count;
+    uint8_t bits_per_item;
+    uint64_t queries;
+    uint64_t positives;
+    uint64_t false_positives;
+} bloom_filter;
+
+#endif
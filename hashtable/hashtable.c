@@ -1,6 +1,38 @@
-#include "hashtable_struct.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-void *hashtable_get_val(hashtable *table, char *key);
+#include "hashtable.h"
+#include "spt_linkedlist/str_ptr_tuple/str_ptr_tuple.h"
+#include "../crash_test/err/err.h"
+
+// Returns the time in milliseconds on a clock which never goes backwards
+uint64_t _hashtable_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Returns the value of an entry: a pointer to the value itself in an inline 
+// hashtable, else the value pointer stored in the entry
+void *_hashtable_get_value(hashtable *table, str_ptr_tuple *tuple) {
+    if (table->value_size > 0) return str_ptr_tuple_get_ptr_slot(tuple);
+    return str_ptr_tuple_get_ptr(tuple);
+}
+
+unsigned long hashtable_hash(char *key) {
+    return _hashtable_get_hash(key);
+}
+
+uint32_t hashtable_hash_to_shard(unsigned long hash, uint32_t shard_count) {
+    // Take the shard from the high bits of a mix of the hash. Taking it from 
+    // hash % shard_count would leave each shard using only the buckets whose 
+    // ids are congruent to its own.
+    uint64_t mixed = ((uint64_t) hash * 0x9e3779b97f4a7c15ULL) >> 32;
+    return (uint32_t) ((mixed * shard_count) >> 32);
+}
 
 unsigned long _hashtable_get_hash(char *str) {
     unsigned long hash = 5381;
@@ -15,28 +47,238 @@ unsigned long _hashtable_get_hash(char *str) {
     return hash;
 }
 
-hashtable *hashtable_init(uint16_t capacity, bool is_dynamic) {
+uint32_t _hashtable_get_refcount(uint32_t *refcount) {
+    return __atomic_load_n(refcount, __ATOMIC_ACQUIRE);
+}
+
+hashtable_page_dir *_hashtable_dir_init(uint32_t capacity) {
+    uint32_t page_count = (uint32_t) (((uint64_t) capacity + HASHTABLE_PAGE_SIZE - 1) >> HASHTABLE_PAGE_BITS);
+    hashtable_page_dir *dir = malloc(sizeof(hashtable_page_dir) + page_count * sizeof(hashtable_page *));
+
+    dir->refcount = 1;
+    dir->page_count = page_count;
+
+    for (uint32_t i = 0; i < page_count; i++) {
+        dir->pages[i] = calloc(1, sizeof(hashtable_page));
+        dir->pages[i]->refcount = 1;
+    }
+
+    return dir;
+}
+
+void _hashtable_release_page(hashtable_page *page) {
+    if (__atomic_sub_fetch(&page->refcount, 1, __ATOMIC_ACQ_REL) > 0) return;
+
+    for (int i = 0; i < HASHTABLE_PAGE_SIZE; i++) {
+        spt_linkedlist_clear(page->buckets + i);
+    }
+
+    free(page);
+}
+
+void _hashtable_release_dir(hashtable_page_dir *dir) {
+    if (!dir) return;
+    if (__atomic_sub_fetch(&dir->refcount, 1, __ATOMIC_ACQ_REL) > 0) return;
+
+    for (uint32_t i = 0; i < dir->page_count; i++) {
+        _hashtable_release_page(dir->pages[i]);
+    }
+
+    free(dir);
+}
+
+// A node in a page shared with a snapshot may be copied by the snapshot's 
+// thread (in hashtable_clone_deep or hashtable_intersect) while the hashtable it
+// was taken from marks the node referenced or moves its timer. Both sides access
+// these fields atomically. The snapshot never follows the timer, so relaxed 
+// ordering is enough.
+bool _hashtable_is_referenced(spt_linkedlist_node *node) {
+    return __atomic_load_n(&node->is_referenced, __ATOMIC_RELAXED);
+}
+
+void _hashtable_set_referenced(spt_linkedlist_node *node, bool is_referenced) {
+    __atomic_store_n(&node->is_referenced, is_referenced, __ATOMIC_RELAXED);
+}
+
+timing_wheel_timer *_hashtable_get_timer(spt_linkedlist_node *node) {
+    return __atomic_load_n(&node->timer, __ATOMIC_RELAXED);
+}
+
+void _hashtable_set_timer(spt_linkedlist_node *node, timing_wheel_timer *timer) {
+    __atomic_store_n(&node->timer, timer, __ATOMIC_RELAXED);
+}
+
+// Copies a node of src into a new node for dest. If dest is src, the copy is 
+// replacing the node within src, so it takes over the node's expiry timer.
+spt_linkedlist_node *_hashtable_copy_node(hashtable *src, hashtable *dest, spt_linkedlist_node *node) {
+    str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(node);
+    spt_linkedlist_node *copy = spt_linkedlist_node_init_inline(str_ptr_tuple_get_str(tuple), _hashtable_get_value(src, tuple), src->value_size);
+
+    str_ptr_tuple_set_hash(spt_linkedlist_node_get_tuple(copy), str_ptr_tuple_get_hash(tuple));
+    copy->is_referenced = _hashtable_is_referenced(node);
+
+    timing_wheel_timer *timer = _hashtable_get_timer(node);
+
+    if (timer && dest == src) {
+        copy->timer = timer;
+        copy->timer->owner = copy;
+
+        // Only src follows the timers of its nodes, so clearing this is safe 
+        // even while a snapshot is reading the page node is in
+        _hashtable_set_timer(node, NULL);
+    } else if (timer && dest->wheel) {
+        copy->timer = timing_wheel_schedule(dest->wheel, timer->expires, copy);
+    }
+
+    return copy;
+}
+
+// Copies every chain in a page of src, in order, into a new page for dest. If 
+// translate points to a node in the page, it is updated to point to its copy.
+hashtable_page *_hashtable_copy_page(hashtable *src, hashtable *dest, hashtable_page *page, spt_linkedlist_node **translate) {
+    hashtable_page *copy = calloc(1, sizeof(hashtable_page));
+    copy->refcount = 1;
+
+    for (int i = 0; i < HASHTABLE_PAGE_SIZE; i++) {
+        spt_linkedlist_node *tail = NULL;
+        spt_linkedlist_node *curr = spt_linkedlist_get_head(page->buckets + i);
+
+        while (curr) {
+            spt_linkedlist_node *node = _hashtable_copy_node(src, dest, curr);
+
+            if (tail) {
+                spt_linkedlist_node_set_next(tail, node);
+            } else {
+                copy->buckets[i].head = node;
+            }
+            tail = node;
+
+            if (translate && *translate == curr) *translate = node;
+
+            curr = spt_linkedlist_node_get_next(curr);
+        }
+
+        copy->buckets[i].size = spt_linkedlist_get_size(page->buckets + i);
+    }
+
+    return copy;
+}
+
+spt_linkedlist *_hashtable_get_bucket_by_id(hashtable *table, uint32_t id) {
+    return table->dir->pages[id >> HASHTABLE_PAGE_BITS]->buckets + (id & (HASHTABLE_PAGE_SIZE - 1));
+}
+
+// Returns the front cache entry which a hash maps to. The slot comes from the 
+// low bits of a different mix to hashtable_hash_to_shard's, since every key of
+// a hashtable used as one shard has the same high bits of that mix.
+hashtable_front_entry *_hashtable_front_get_entry(hashtable *table, unsigned long hash) {
+    uint64_t mixed = (uint64_t) hash * 0xff51afd7ed558ccdULL;
+    mixed ^= mixed >> 33;
+
+    return table->front + mixed % table->front_size;
+}
+
+// Forgets every node in the front cache, if there is one
+void _hashtable_front_clear(hashtable *table) {
+    if (table->front) memset(table->front, 0, table->front_size * sizeof(hashtable_front_entry));
+}
+
+// Forgets a node which is about to be destroyed, if the front cache holds it
+void _hashtable_front_invalidate(hashtable *table, spt_linkedlist_node *node) {
+    if (!table->front) return;
+
+    hashtable_front_entry *entry = _hashtable_front_get_entry(table, str_ptr_tuple_get_hash(spt_linkedlist_node_get_tuple(node)));
+    if (entry->node == node) entry->node = NULL;
+}
+
+// Returns a bucket which the hashtable can modify, first copying its page (and
+// the page directory) if they are shared with a snapshot. If translate points to
+// a node in a copied page, it is updated to point to its copy.
+spt_linkedlist *_hashtable_get_bucket_for_write(hashtable *table, uint32_t id, spt_linkedlist_node **translate) {
+    hashtable_page_dir *dir = table->dir;
+
+    if (_hashtable_get_refcount(&dir->refcount) > 1) {
+        hashtable_page_dir *copy = malloc(sizeof(hashtable_page_dir) + dir->page_count * sizeof(hashtable_page *));
+        copy->refcount = 1;
+        copy->page_count = dir->page_count;
+
+        for (uint32_t i = 0; i < dir->page_count; i++) {
+            copy->pages[i] = dir->pages[i];
+            __atomic_add_fetch(&copy->pages[i]->refcount, 1, __ATOMIC_ACQ_REL);
+        }
+
+        _hashtable_release_dir(dir);
+        table->dir = dir = copy;
+    }
+
+    hashtable_page **page = dir->pages + (id >> HASHTABLE_PAGE_BITS);
+
+    if (_hashtable_get_refcount(&(*page)->refcount) > 1) {
+        hashtable_page *copy = _hashtable_copy_page(table, table, *page, translate);
+
+        _hashtable_front_clear(table);
+        _hashtable_release_page(*page);
+        *page = copy;
+    }
+
+    return (*page)->buckets + (id & (HASHTABLE_PAGE_SIZE - 1));
+}
+
+hashtable *hashtable_init(uint32_t capacity, bool is_dynamic) {
     if (capacity == 0) {
         err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to initialize a hashtable of capacity zero", "Returning null");
         return NULL;
     }
 
-    hashtable *table = malloc(sizeof(table));
+    hashtable *table = malloc(sizeof(hashtable));
 
     table->is_dynamic = is_dynamic;
     table->capacity = capacity;
     table->size = 0;
-    table->buckets = calloc(capacity, sizeof(spt_linkedlist));
+    table->dir = _hashtable_dir_init(capacity);
+    table->is_snapshot = false;
+    table->value_size = 0;
+    table->filter = NULL;
+    table->filter_stale = 0;
+    table->max_entries = 0;
+    table->clock_hand = 0;
+    table->on_evict = NULL;
+    table->evict_ctx = NULL;
+    table->hits = 0;
+    table->misses = 0;
+    table->evictions = 0;
+    table->expirations = 0;
+    table->wheel = NULL;
+    table->front = NULL;
+    table->front_size = 0;
+    table->front_hits = 0;
+    table->front_misses = 0;
+
+    return table;
+}
+
+hashtable *hashtable_init_inline(uint32_t capacity, bool is_dynamic, uint32_t value_size) {
+    hashtable *table = hashtable_init(capacity, is_dynamic);
+
+    // hashtable_init has already raised an error if this failed
+    if (table) {
+        table->value_size = value_size;
+    }
 
     return table;
 }
 
-uint16_t hashtable_get_size(hashtable *table) {
+uint32_t hashtable_get_value_size(hashtable *table) {
+    if (!table) return 0;
+    return table->value_size;
+}
+
+uint32_t hashtable_get_size(hashtable *table) {
     if (!table) return 0;
     return table->size;
 }
 
-uint16_t hashtable_get_capacity(hashtable *table) {
+uint32_t hashtable_get_capacity(hashtable *table) {
     if (!table) return 0;
     return table->capacity;
 }
@@ -57,154 +299,1339 @@ bool hashtable_is_empty(hashtable *table) {
     return (hashtable_get_size(table) != 0);
 }
 
-uint16_t hashtable_get_bucket_id(hashtable *table, char *key) { 
+uint32_t hashtable_get_bucket_id(hashtable *table, char *key) { 
     return _hashtable_get_hash(key) % hashtable_get_capacity(table);
 }
 
 spt_linkedlist *hashtable_get_bucket(hashtable *table, char *key) {
-    return &(table->buckets[hashtable_get_bucket_id(table, key)]);
+    return _hashtable_get_bucket_by_id(table, hashtable_get_bucket_id(table, key));
 }
 
-bool hashtable_contains_key(hashtable *table, char *key) {
-    if (!table) {
-        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to access a null hashtable", "Returning false");
-        return false;
+spt_linkedlist *_hashtable_get_bucket_by_hash(hashtable *table, unsigned long hash) {
+    return _hashtable_get_bucket_by_id(table, hash % hashtable_get_capacity(table));
+}
+
+// Returns the node holding key, consulting the filter before the bucket
+spt_linkedlist_node *_hashtable_find_node(hashtable *table, char *key, unsigned long hash) {
+    if (!bloom_filter_might_contain(table->filter, hash)) return NULL;
+
+    spt_linkedlist_node *node = spt_linkedlist_get_node_by_hashed_str(_hashtable_get_bucket_by_hash(table, hash), hash, key);
+    if (!node) {
+        // bloom_filter_record_false_positive ignores a NULL filter
+        bloom_filter_record_false_positive(table->filter);
+    }
+
+    return node;
+}
+
+typedef void *(*_hashtable_task_fn)(void *);
+
+// Runs fn on each of nthreads task structs of task_size bytes, each in its own
+// thread. The first task runs in the calling thread, as does any task whose
+// thread couldn't be created, so this always completes every task.
+void _hashtable_run_parallel(_hashtable_task_fn fn, void *tasks, size_t task_size, uint32_t nthreads) {
+    pthread_t threads[HASHTABLE_MAX_THREADS];
+    bool is_started[HASHTABLE_MAX_THREADS] = { false };
+
+    for (uint32_t i = 1; i < nthreads; i++) {
+        is_started[i] = pthread_create(threads + i, NULL, fn, (char *) tasks + i * task_size) == 0;
+    }
+
+    for (uint32_t i = 0; i < nthreads; i++) {
+        if (!is_started[i]) fn((char *) tasks + i * task_size);
+    }
+
+    for (uint32_t i = 1; i < nthreads; i++) {
+        if (is_started[i]) pthread_join(threads[i], NULL);
     }
-    spt_linkedlist_node *head = spt_linkedlist_get_head(hashtable_get_bucket(table, key));
-    return head;
 }
 
-spt_linkedlist *hashtable_get_buckets(hashtable *table) {
-    if (!table) return NULL;
-    return table->buckets;
+// Clamps a requested thread count to [1, HASHTABLE_MAX_THREADS]
+uint32_t _hashtable_get_thread_count(uint32_t nthreads) {
+    if (nthreads == 0) return 1;
+    if (nthreads > HASHTABLE_MAX_THREADS) return HASHTABLE_MAX_THREADS;
+    return nthreads;
 }
 
-bool hashtable_expand_and_rehash(hashtable *table) {
-    uint32_t new_capacity = hashtable_get_capacity(table) * 2;
+// Moves the entries of buckets [begin, end) of old_dir into a hashtable which 
+// has just doubled in capacity. Old bucket i can only map to new bucket i or 
+// i + old capacity, so calls on disjoint ranges write disjoint buckets and may
+// run in parallel.
+void _hashtable_rehash_range(hashtable *table, hashtable_page_dir *old_dir, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; i++) {
+        hashtable_page *page = old_dir->pages[i >> HASHTABLE_PAGE_BITS];
+        spt_linkedlist *bucket = page->buckets + (i & (HASHTABLE_PAGE_SIZE - 1));
+
+        // Nodes in a page shared with a snapshot are copied, leaving the 
+        // snapshot's nodes intact
+        if (_hashtable_get_refcount(&old_dir->refcount) > 1 || _hashtable_get_refcount(&page->refcount) > 1) {
+            for (spt_linkedlist_node *curr = spt_linkedlist_get_head(bucket); curr; curr = spt_linkedlist_node_get_next(curr)) {
+                unsigned long hash = str_ptr_tuple_get_hash(spt_linkedlist_node_get_tuple(curr));
+                spt_linkedlist_add(_hashtable_get_bucket_by_hash(table, hash), _hashtable_copy_node(table, table, curr));
+            }
+            continue;
+        }
+
+        // Bucket sizes are only 16 bits wide and may have wrapped, so pop until
+        // the chain is empty rather than counting its size down
+        while (spt_linkedlist_get_head(bucket)) {
+            spt_linkedlist_node *node = spt_linkedlist_pop(bucket);
+            str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(node);
+
+            // Use the cached hash rather than hashing the key again
+            spt_linkedlist *new_bucket = _hashtable_get_bucket_by_hash(table, str_ptr_tuple_get_hash(tuple));
+
+            // Relink the popped node rather than allocating a new one for it
+            spt_linkedlist_node_set_next(node, NULL);
+            spt_linkedlist_add(new_bucket, node);
+        }
+    }
+}
+
+typedef struct _hashtable_rehash_task {
+    hashtable *table;
+    hashtable_page_dir *old_dir;
+    uint32_t begin;
+    uint32_t end;
+} _hashtable_rehash_task;
+
+void *_hashtable_rehash_run(void *arg) {
+    _hashtable_rehash_task *task = arg;
+    _hashtable_rehash_range(task->table, task->old_dir, task->begin, task->end);
+
+    return NULL;
+}
+
+// Doubles the capacity of a hashtable, splitting the rehash of its old buckets
+// between nthreads threads
+bool _hashtable_expand(hashtable *table, uint32_t nthreads) {
+    if (table && table->is_snapshot) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to resize a snapshot", "Returning false");
+        return false;
+    }
+
+    uint64_t new_capacity = (uint64_t) hashtable_get_capacity(table) * 2;
 
     // Check that the new capacity is below our max permitted capacity
-    if (new_capacity > UINT16_MAX) {
+    if (new_capacity > UINT32_MAX) {
         err_init_and_handle(AERR_MAX_CAPACITY, WARNING, __func__, "Attempted to resize hashtable beyond the max capacity.", "Hashmap will remain at current capacity; Returning false");
         return false;
     }
 
-    // Create the new hashtable. 
-    // If we try initialize from table == NULL then an error will be thrown.
-    hashtable *new_table = hashtable_init((uint16_t) new_capacity, hashtable_is_dynamic(table));
+    // MID: table != NULL
+    uint32_t old_capacity = hashtable_get_capacity(table);
+    hashtable_page_dir *old_dir = table->dir;
+
+    // The new directory isn't shared, so we can write to its buckets directly
+    table->dir = _hashtable_dir_init((uint32_t) new_capacity);
+    table->capacity = (uint32_t) new_capacity;
+
+    // Split the old buckets into whole pages, so that each page we pop nodes 
+    // from is only written by one thread
+    nthreads = _hashtable_get_thread_count(nthreads);
+    if (nthreads > old_dir->page_count) nthreads = old_dir->page_count;
+
+    _hashtable_rehash_task tasks[HASHTABLE_MAX_THREADS];
+    for (uint32_t t = 0; t < nthreads; t++) {
+        uint64_t page_begin = ((uint64_t) old_dir->page_count * t) / nthreads;
+        uint64_t page_end = ((uint64_t) old_dir->page_count * (t + 1)) / nthreads;
+
+        tasks[t].table = table;
+        tasks[t].old_dir = old_dir;
+        tasks[t].begin = (uint32_t) (page_begin << HASHTABLE_PAGE_BITS);
+        tasks[t].end = (uint32_t) ((page_end << HASHTABLE_PAGE_BITS) < old_capacity ? (page_end << HASHTABLE_PAGE_BITS) : old_capacity);
+    }
+
+    _hashtable_run_parallel(_hashtable_rehash_run, tasks, sizeof(_hashtable_rehash_task), nthreads);
+
+    // Pages we emptied are freed, and shared pages are left to the snapshots.
+    // Nodes in shared pages were copied, so the front cache may be stale.
+    _hashtable_release_dir(old_dir);
+    _hashtable_front_clear(table);
+
+    // The filter was sized for the old capacity, so resize it along with the
+    // buckets. This also clears out the bits of any removed keys.
+    if (table->filter) {
+        hashtable_enable_filter(table, table->filter->bits_per_item);
+    }
+    
+    return true;
+}
+
+bool hashtable_expand_and_rehash(hashtable *table) {
+    return _hashtable_expand(table, 1);
+}
+
+bool hashtable_expand_and_rehash_parallel(hashtable *table, uint32_t nthreads) {
+    return _hashtable_expand(table, nthreads);
+}
+
+void _hashtable_rebuild_filter(hashtable *table) {
+    bloom_filter_clear(table->filter);
+    table->filter_stale = 0;
+
+    for (uint32_t i = 0; i < hashtable_get_capacity(table); i++) {
+        spt_linkedlist_node *curr = spt_linkedlist_get_head(_hashtable_get_bucket_by_id(table, i));
+
+        while (curr) {
+            bloom_filter_add(table->filter, str_ptr_tuple_get_hash(spt_linkedlist_node_get_tuple(curr)));
+            curr = spt_linkedlist_node_get_next(curr);
+        }
+    }
+}
+
+bool hashtable_enable_filter(hashtable *table, uint8_t bits_per_key) {
+    if (!table) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to enable the filter of a null hashtable", "Returning false");
+        return false;
+    }
 
-    // Check if the initialization failed, and cut before the for loop.
-    if (!new_table) {
-        err_init_and_handle(AERR_FAILURE, WARNING, __func__, "Failed to resize hashtable.", "Hashmap will remain at current capacity; Returning false");
+    bloom_filter *filter = bloom_filter_init(hashtable_get_capacity(table), bits_per_key);
+    if (!filter) {
+        err_init_and_handle(AERR_FAILURE, WARNING, __func__, "Failed to create a filter for the hashtable", "Hashtable filter is unchanged; Returning false");
         return false;
     }
 
-    // MID: table != NULL && new_table != NULL
-    spt_linkedlist *head_bucket = hashtable_get_buckets(table);
+    // Carry the counters over so that the stats cover the hashtable's lifetime
+    if (table->filter) {
+        filter->queries = table->filter->queries;
+        filter->positives = table->filter->positives;
+        filter->false_positives = table->filter->false_positives;
+    }
 
-    // One-by-one add the old buckets to the new table
-    for (int i = 0; i > hashtable_get_capacity(table); i++) {
+    bloom_filter_destroy(table->filter);
+    table->filter = filter;
+    _hashtable_rebuild_filter(table);
 
-        spt_linkedlist *bucket = head_bucket + i;
+    return true;
+}
 
-        while (spt_linkedlist_get_size(bucket) > 0) {
-            str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(spt_linkedlist_pop(bucket));
-            spt_linkedlist *new_bucket = hashtable_get_bucket(new_table, str_ptr_tuple_get_str(tuple));
-            
-            // Make the tuple into a new node to add to the list
-            spt_linkedlist_node *node = spt_linkedlist_node_init(tuple);
-            spt_linkedlist_add(new_bucket, node);
+void hashtable_disable_filter(hashtable *table) {
+    if (!table) return;
+
+    bloom_filter_destroy(table->filter);
+    table->filter = NULL;
+    table->filter_stale = 0;
+}
+
+// Does the bookkeeping for an entry which has been taken out of the hashtable
+void _hashtable_on_removed(hashtable *table) {
+    table->size--;
+
+    // A bloom filter can't unset the bits of one key, so we rebuild the filter
+    // once as many keys have been removed as it was sized for. A rebuild walks
+    // every bucket, so this keeps it amortized O(1) per remove however sparse 
+    // the hashtable is, and the filter holds at most about twice the keys it 
+    // was sized for.
+    if (table->filter && ++table->filter_stale > hashtable_get_capacity(table)) {
+        _hashtable_rebuild_filter(table);
+    }
+}
+
+// Unlinks and destroys a node, whose predecessor in bucket is prev. Evicted and
+// expired nodes are passed to the on_evict callback first.
+void _hashtable_drop_node(hashtable *table, spt_linkedlist *bucket, spt_linkedlist_node *prev, spt_linkedlist_node *node, bool is_evicted) {
+    spt_linkedlist_unlink_node(bucket, prev, node);
+    _hashtable_front_invalidate(table, node);
+
+    timing_wheel_cancel(table->wheel, node->timer);
+    node->timer = NULL;
+
+    if (is_evicted && table->on_evict) {
+        str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(node);
+        table->on_evict(str_ptr_tuple_get_str(tuple), _hashtable_get_value(table, tuple), table->evict_ctx);
+    }
+
+    spt_linkedlist_node_destroy(node);
+    _hashtable_on_removed(table);
+}
+
+// Returns the node before node in bucket, or NULL if node is the head
+spt_linkedlist_node *_hashtable_find_prev(spt_linkedlist *bucket, spt_linkedlist_node *node) {
+    spt_linkedlist_node *prev = NULL;
+    spt_linkedlist_node *curr = spt_linkedlist_get_head(bucket);
+
+    while (curr && curr != node) {
+        prev = curr;
+        curr = spt_linkedlist_node_get_next(curr);
+    }
+
+    return prev;
+}
+
+void _hashtable_expire_node(hashtable *table, spt_linkedlist_node *node) {
+    unsigned long hash = str_ptr_tuple_get_hash(spt_linkedlist_node_get_tuple(node));
+    spt_linkedlist *bucket = _hashtable_get_bucket_for_write(table, hash % hashtable_get_capacity(table), &node);
+
+    _hashtable_drop_node(table, bucket, _hashtable_find_prev(bucket, node), node, true);
+    table->expirations++;
+}
+
+bool _hashtable_is_expired(hashtable *table, spt_linkedlist_node *node) {
+    // Nodes in a snapshot may still point to timers of the live hashtable, which
+    // only the live hashtable (with a wheel) may read
+    return table->wheel && node->timer && node->timer->expires <= _hashtable_now_ms();
+}
+
+uint32_t hashtable_expire(hashtable *table, uint32_t max_expirations) {
+    if (!table || !table->wheel) return 0;
+
+    uint64_t now = _hashtable_now_ms();
+    uint32_t expired = 0;
+
+    while (expired < max_expirations) {
+        spt_linkedlist_node *node = timing_wheel_expire_next(table->wheel, now);
+        if (!node) break;
+
+        // The wheel has already freed the timer
+        _hashtable_set_timer(node, NULL);
+        _hashtable_expire_node(table, node);
+        expired++;
+    }
+
+    return expired;
+}
+
+// Evicts one entry chosen by CLOCK. Returns false iff there was nothing to evict.
+bool _hashtable_evict(hashtable *table) {
+    if (hashtable_get_size(table) == 0) return false;
+
+    // Every pass clears the reference bits it passes over, so the hand finds an
+    // unreferenced entry within two passes of the buckets
+    while (true) {
+        spt_linkedlist *bucket = _hashtable_get_bucket_for_write(table, table->clock_hand, NULL);
+        table->clock_hand = (table->clock_hand + 1) % hashtable_get_capacity(table);
+
+        spt_linkedlist_node *prev = NULL;
+        spt_linkedlist_node *curr = spt_linkedlist_get_head(bucket);
+
+        while (curr && curr->is_referenced) {
+            curr->is_referenced = false;
+            prev = curr;
+            curr = spt_linkedlist_node_get_next(curr);
         }
+
+        if (!curr) continue;
+
+        // MID: curr is the first unreferenced entry in the bucket
+        _hashtable_drop_node(table, bucket, prev, curr, true);
+        table->evictions++;
+
+        return true;
+    }
+}
+
+bool hashtable_set_cache_mode(hashtable *table, uint32_t max_entries, hashtable_evict_fn on_evict, void *ctx) {
+    if (!table) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to set the cache mode of a null hashtable", "Returning false");
+        return false;
+    }
+    if (table->is_snapshot) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to set the cache mode of a snapshot", "Returning false");
+        return false;
     }
 
-    // Update the hashtable's properties
-    table->capacity = new_table->capacity;
-    table->size = new_table->size;
-    table->buckets = new_table->buckets;
-    table->is_dynamic = new_table->is_dynamic;
+    table->max_entries = max_entries;
+    table->on_evict = on_evict;
+    table->evict_ctx = ctx;
+
+    if (max_entries == 0) return true;
+
+    while (hashtable_get_size(table) > max_entries) {
+        _hashtable_evict(table);
+    }
 
-    free(head_bucket);
-    free(new_table);
-    
     return true;
 }
 
-bool hashtable_add(hashtable *table, char *key, void *val) {
-    // Check hashtable has the space to store this new val
-    if (hashtable_get_size(table) >= hashtable_get_capacity(table)) {
-        err_init_and_handle(AERR_MAX_CAPACITY, WARNING, __func__, "Attempted to add to a full hashtable", "Aborting add; Returning false");
+hashtable_stats hashtable_get_stats(hashtable *table) {
+    hashtable_stats stats = {0};
+    if (!table) return stats;
+
+    stats.hits = table->hits;
+    stats.misses = table->misses;
+    stats.evictions = table->evictions;
+    stats.expirations = table->expirations;
+    stats.front_hits = table->front_hits;
+    stats.front_misses = table->front_misses;
+
+    if (table->front_hits + table->front_misses > 0) {
+        stats.front_hit_rate = (double) table->front_hits / (double) (table->front_hits + table->front_misses);
+    }
+
+    if (table->filter) {
+        stats.filter_queries = table->filter->queries;
+        stats.filter_false_positives = table->filter->false_positives;
+        stats.filter_false_positive_rate = bloom_filter_get_false_positive_rate(table->filter);
+    }
+
+    return stats;
+}
+
+// Makes room for one more entry, evicting in cache mode. Returns false iff the
+// hashtable is full (or read-only).
+bool _hashtable_make_room(hashtable *table) {
+    if (table && table->is_snapshot) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to add to a snapshot", "Aborting add; Returning false");
         return false;
     }
 
-    // TODO Why do we only have this for NULL and not all strings?
-    // Check for NULL case -- we only permit one NULL key.
-    if (key == NULL && hashtable_contains_key(table, NULL)) {
-        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to add multiple null keys to a hashtable", "Aborting add; Returning false");
+    // A cache makes room by evicting, both to stay within its budget and when 
+    // it has filled a hashtable which can't grow
+    if (table && table->max_entries > 0) {
+        while (hashtable_get_size(table) >= table->max_entries || 
+                (!hashtable_is_dynamic(table) && hashtable_get_size(table) >= hashtable_get_capacity(table))
+              ) {
+            if (!_hashtable_evict(table)) break;
+        }
+    }
+
+    // Check hashtable has the space to store this new val. Dynamic hashtables 
+    // are expanded by _hashtable_grow instead.
+    if (!hashtable_is_dynamic(table) && hashtable_get_size(table) >= hashtable_get_capacity(table)) {
+        err_init_and_handle(AERR_MAX_CAPACITY, WARNING, __func__, "Attempted to add to a full hashtable", "Aborting add; Returning false");
         return false;
     }
 
-    spt_linkedlist* bucket = hashtable_get_bucket(table, key);
+    return true;
+}
+
+// Links a new entry into the head of its bucket, which must be writable
+spt_linkedlist_node *_hashtable_insert_node(hashtable *table, spt_linkedlist *bucket, char *key, unsigned long hash, void *val) {
+    // One allocation holds the node, its tuple and (in inline hashtables) the
+    // value itself
+    spt_linkedlist_node *node = spt_linkedlist_node_init_inline(key, val, table->value_size);
+    str_ptr_tuple_set_hash(spt_linkedlist_node_get_tuple(node), hash);
 
-    spt_linkedlist_node *node = spt_linkedlist_node_init(str_ptr_tuple_init(key, val));
-    bool is_success = spt_linkedlist_add(bucket, node);
+    spt_linkedlist_add(bucket, node);
+    table->size++;
+    bloom_filter_add(table->filter, hash);
 
-    if (is_success) {
-        table->size++;
-    }
+    return node;
+}
 
-    // If we added to a dynamic hashtable whose size exceeds its capacity then 
-    // expand and rehash it
+// If a dynamic hashtable's size exceeds its capacity then expand and rehash it.
+// Rehashing relinks the nodes of pages we have written to rather than copying 
+// them, so pointers to recently inserted nodes stay valid.
+void _hashtable_grow(hashtable *table) {
     if (hashtable_is_dynamic(table) && 
             (hashtable_get_size(table) > hashtable_get_capacity(table))
        ) {
         hashtable_expand_and_rehash(table);
     }
-
-    return is_success;
 }
 
-bool hashtable_remove(hashtable *table, char *key) { 
-    spt_linkedlist* bucket = hashtable_get_bucket(table, key);
-
-    return spt_linkedlist_remove_node_by_str(bucket, key);
-}
+// Adds a new entry to the hashtable. Returns its node, or NULL if it couldn't be
+// added.
+spt_linkedlist_node *_hashtable_add_node(hashtable *table, char *key, unsigned long hash, void *val) {
+    if (!_hashtable_make_room(table)) return NULL;
 
-void *hashtable_get_val(hashtable *table, char *key) {
-    if (!table) {
-        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to access a null hashtable", "Returning null");
+    // TODO Why do we only have this for NULL and not all strings?
+    // Check for NULL case -- we only permit one NULL key.
+    if (key == NULL && hashtable_contains_key(table, NULL)) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to add multiple null keys to a hashtable", "Aborting add; Returning false");
         return NULL;
     }
 
-    spt_linkedlist *bucket = hashtable_get_bucket(table, key);
-    str_ptr_tuple *tuple = spt_linkedlist_find_str(bucket, key);
+    spt_linkedlist* bucket = _hashtable_get_bucket_for_write(table, hash % hashtable_get_capacity(table), NULL);
 
-    // !table implies !tuple, so this checks !table too
-    // We nonetheless included the check above to throw an error message.
-    if (!tuple) return NULL;
-    
-    spt_linkedlist_node *bucket_head = spt_linkedlist_get_head(bucket);
-    return str_ptr_tuple_get_ptr(spt_linkedlist_node_get_tuple(bucket_head));
+    spt_linkedlist_node *node = _hashtable_insert_node(table, bucket, key, hash, val);
+    _hashtable_grow(table);
+
+    return node;
 }
 
-void *hashtable_clone(hashtable *table) {
-    uint16_t capacity = hashtable_get_capacity(table);
-    bool is_dynamic = hashtable_is_dynamic(table);
+bool hashtable_add(hashtable *table, char *key, void *val) {
+    return hashtable_add_with_hash(table, key, val, _hashtable_get_hash(key));
+}
 
-    return hashtable_init(capacity, is_dynamic);
+bool hashtable_add_with_hash(hashtable *table, char *key, void *val, unsigned long hash) {
+    hashtable_expire(table, HASHTABLE_EXPIRE_STEP);
+
+    return _hashtable_add_node(table, key, hash, val);
 }
 
-void hashtable_clear(hashtable *table) {
-    // Cuts from the loop early
-    if (!table) return;
+bool hashtable_add_with_ttl(hashtable *table, char *key, void *val, uint64_t ttl_ms) {
+    hashtable_expire(table, HASHTABLE_EXPIRE_STEP);
 
-    spt_linkedlist *buckets = hashtable_get_buckets(table);
-    for (int i = 0; i < hashtable_get_capacity(table); i++) {
-       spt_linkedlist_destroy(buckets + i);
+    spt_linkedlist_node *node = _hashtable_add_node(table, key, _hashtable_get_hash(key), val);
+    if (!node) return false;
+    if (ttl_ms == 0) return true;
+
+    uint64_t now = _hashtable_now_ms();
+    if (!table->wheel) {
+        table->wheel = timing_wheel_init(now);
     }
+
+    node->timer = timing_wheel_schedule(table->wheel, now + ttl_ms, node);
+    return true;
 }
 
-void hashtable_destroy(hashtable *table) {
-    hashtable_clear(table);
+bool hashtable_remove(hashtable *table, char *key) { 
+    return hashtable_remove_with_hash(table, key, _hashtable_get_hash(key));
+}
+
+bool hashtable_remove_with_hash(hashtable *table, char *key, unsigned long hash) {
+    if (!table) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to remove from a null hashtable", "Returning false");
+        return false;
+    }
+    if (table->is_snapshot) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to remove from a snapshot", "Returning false");
+        return false;
+    }
+
+    spt_linkedlist *bucket = _hashtable_get_bucket_for_write(table, hash % hashtable_get_capacity(table), NULL);
+
+    spt_linkedlist_node *prev = NULL;
+    spt_linkedlist_node *curr = spt_linkedlist_get_head(bucket);
+
+    while (curr) {
+        str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(curr);
+        if (str_ptr_tuple_get_hash(tuple) == hash && str_ptr_tuple_strcmp(tuple, key)) break;
+
+        prev = curr;
+        curr = spt_linkedlist_node_get_next(curr);
+    }
+
+    if (!curr) return false;
+
+    _hashtable_drop_node(table, bucket, prev, curr, false);
+    return true;
+}
+
+void _hashtable_set_value(hashtable *table, str_ptr_tuple *tuple, void *val) {
+    if (table->value_size == 0) {
+        str_ptr_tuple_set_ptr(tuple, val);
+    } else if (val) {
+        memcpy(str_ptr_tuple_get_ptr_slot(tuple), val, table->value_size);
+    } else {
+        memset(str_ptr_tuple_get_ptr_slot(tuple), 0, table->value_size);
+    }
+}
+
+// Finds the entry for key with one hash and one walk of its bucket, inserting 
+// an entry holding val if there is none. Sets bucket and prev to where the node
+// is linked, so that the caller can unlink it. The caller must call 
+// _hashtable_grow afterwards, which may move the node to another bucket.
+// Returns the entry's node, or NULL if it had to be inserted but couldn't be.
+spt_linkedlist_node *_hashtable_upsert_node(hashtable *table, char *key, unsigned long hash, void *val, bool *inserted, spt_linkedlist **bucket, spt_linkedlist_node **prev) {
+    *inserted = false;
+
+    // Fetching a bucket for write would copy a snapshot's page, and with it the
+    // expiry timers of the hashtable it was taken from
+    if (table->is_snapshot) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to write to a snapshot", "Returning null");
+        return NULL;
+    }
+
+    uint32_t id = hash % hashtable_get_capacity(table);
+
+    *bucket = _hashtable_get_bucket_for_write(table, id, NULL);
+    *prev = NULL;
+
+    spt_linkedlist_node *curr = spt_linkedlist_get_head(*bucket);
+
+    while (curr) {
+        str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(curr);
+        if (str_ptr_tuple_get_hash(tuple) == hash && str_ptr_tuple_strcmp(tuple, key)) break;
+
+        *prev = curr;
+        curr = spt_linkedlist_node_get_next(curr);
+    }
+
+    if (curr && !_hashtable_is_expired(table, curr)) {
+        _hashtable_set_referenced(curr, true);
+        return curr;
+    }
+
+    if (curr) {
+        _hashtable_drop_node(table, *bucket, *prev, curr, true);
+        table->expirations++;
+    }
+
+    // Making room may evict from (and so copy the page of) this bucket, so we
+    // fetch it again. The key is absent, so there is nothing to walk.
+    if (!_hashtable_make_room(table)) return NULL;
+
+    *bucket = _hashtable_get_bucket_for_write(table, id, NULL);
+    *prev = NULL;
+    *inserted = true;
+
+    return _hashtable_insert_node(table, *bucket, key, hash, val);
+}
+
+void *hashtable_find_or_insert(hashtable *table, char *key, void *val, bool *inserted) {
+    return hashtable_find_or_insert_with_hash(table, key, val, _hashtable_get_hash(key), inserted);
+}
+
+void *hashtable_find_or_insert_with_hash(hashtable *table, char *key, void *val, unsigned long hash, bool *inserted) {
+    if (!table) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to insert into a null hashtable", "Returning null");
+        return NULL;
+    }
+
+    hashtable_expire(table, HASHTABLE_EXPIRE_STEP);
+
+    bool is_inserted;
+    spt_linkedlist *bucket;
+    spt_linkedlist_node *prev;
+
+    spt_linkedlist_node *node = _hashtable_upsert_node(table, key, hash, val, &is_inserted, &bucket, &prev);
+
+    if (inserted) *inserted = is_inserted;
+    if (!node) return NULL;
+
+    _hashtable_grow(table);
+    return str_ptr_tuple_get_ptr_slot(spt_linkedlist_node_get_tuple(node));
+}
+
+bool hashtable_put(hashtable *table, char *key, void *val) {
+    if (!table) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to put into a null hashtable", "Returning false");
+        return false;
+    }
+
+    hashtable_expire(table, HASHTABLE_EXPIRE_STEP);
+
+    bool is_inserted;
+    spt_linkedlist *bucket;
+    spt_linkedlist_node *prev;
+
+    spt_linkedlist_node *node = _hashtable_upsert_node(table, key, _hashtable_get_hash(key), val, &is_inserted, &bucket, &prev);
+    if (!node) return false;
+
+    if (!is_inserted) {
+        _hashtable_set_value(table, spt_linkedlist_node_get_tuple(node), val);
+    }
+
+    _hashtable_grow(table);
+    return true;
+}
+
+bool hashtable_compute(hashtable *table, char *key, hashtable_compute_fn fn, void *ctx) {
+    if (!table || !fn) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to compute with a null hashtable or function", "Returning false");
+        return false;
+    }
+
+    hashtable_expire(table, HASHTABLE_EXPIRE_STEP);
+
+    bool is_inserted;
+    spt_linkedlist *bucket;
+    spt_linkedlist_node *prev;
+
+    spt_linkedlist_node *node = _hashtable_upsert_node(table, key, _hashtable_get_hash(key), NULL, &is_inserted, &bucket, &prev);
+    if (!node) return false;
+
+    if (!fn(key, str_ptr_tuple_get_ptr_slot(spt_linkedlist_node_get_tuple(node)), is_inserted, ctx)) {
+        _hashtable_drop_node(table, bucket, prev, node, false);
+        return false;
+    }
+
+    _hashtable_grow(table);
+    return true;
+}
+
+bool hashtable_contains_key(hashtable *table, char *key) {
+    return hashtable_contains_key_with_hash(table, key, _hashtable_get_hash(key));
+}
+
+bool hashtable_contains_key_with_hash(hashtable *table, char *key, unsigned long hash) {
+    if (!table) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to access a null hashtable", "Returning false");
+        return false;
+    }
+
+    spt_linkedlist_node *node = _hashtable_find_node(table, key, hash);
+    if (node && _hashtable_is_expired(table, node)) {
+        _hashtable_expire_node(table, node);
+        return false;
+    }
+
+    return node;
+}
+
+void *hashtable_get(hashtable *table, char *key) {
+    return hashtable_get_with_hash(table, key, _hashtable_get_hash(key));
+}
+
+// Looks up a key in the front cache, returning its node or NULL on a miss
+spt_linkedlist_node *_hashtable_front_find(hashtable *table, char *key, unsigned long hash) {
+    hashtable_front_entry *entry = _hashtable_front_get_entry(table, hash);
+
+    // Comparing the key pointers first saves the strcmp for callers which look
+    // up with the stored key itself
+    if (entry->node && entry->hash == hash && 
+            (entry->key == key || str_ptr_tuple_strcmp(spt_linkedlist_node_get_tuple(entry->node), key))
+       ) {
+        table->front_hits++;
+        return entry->node;
+    }
+
+    table->front_misses++;
+    return NULL;
+}
+
+// Remembers a found node in the front cache, and moves it to the head of its 
+// bucket so that the next walk for it is short. Nodes in a page shared with a 
+// snapshot are left where they are, since the snapshot reads the same chain.
+void _hashtable_front_fill(hashtable *table, spt_linkedlist_node *node, unsigned long hash) {
+    hashtable_front_entry *entry = _hashtable_front_get_entry(table, hash);
+
+    entry->hash = hash;
+    entry->key = str_ptr_tuple_get_str(spt_linkedlist_node_get_tuple(node));
+    entry->node = node;
+
+    uint32_t id = hash % hashtable_get_capacity(table);
+    hashtable_page *page = table->dir->pages[id >> HASHTABLE_PAGE_BITS];
+
+    if (_hashtable_get_refcount(&table->dir->refcount) > 1 || _hashtable_get_refcount(&page->refcount) > 1) return;
+
+    spt_linkedlist *bucket = page->buckets + (id & (HASHTABLE_PAGE_SIZE - 1));
+    if (spt_linkedlist_get_head(bucket) == node) return;
+
+    spt_linkedlist_unlink_node(bucket, _hashtable_find_prev(bucket, node), node);
+    spt_linkedlist_add(bucket, node);
+}
+
+bool hashtable_enable_front_cache(hashtable *table, uint32_t entries) {
+    if (!table) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to enable the front cache of a null hashtable", "Returning false");
+        return false;
+    }
+
+    if (entries == 0) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to enable a front cache with no entries", "Front cache is unchanged; Returning false");
+        return false;
+    }
+
+    free(table->front);
+    table->front = calloc(entries, sizeof(hashtable_front_entry));
+    table->front_size = entries;
+
+    return true;
+}
+
+void hashtable_disable_front_cache(hashtable *table) {
+    if (!table) return;
+
+    free(table->front);
+    table->front = NULL;
+    table->front_size = 0;
+}
+
+void *hashtable_get_with_hash(hashtable *table, char *key, unsigned long hash) {
+    if (!table) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to access a null hashtable", "Returning null");
+        return NULL;
+    }
+
+    hashtable_expire(table, HASHTABLE_EXPIRE_STEP);
+
+    spt_linkedlist_node *node = table->front ? _hashtable_front_find(table, key, hash) : NULL;
+
+    if (!node) {
+        node = _hashtable_find_node(table, key, hash);
+        if (!node) {
+            table->misses++;
+            return NULL;
+        }
+
+        if (table->front) _hashtable_front_fill(table, node, hash);
+    }
+
+    if (_hashtable_is_expired(table, node)) {
+        _hashtable_expire_node(table, node);
+        table->misses++;
+        return NULL;
+    }
+
+    table->hits++;
+    _hashtable_set_referenced(node, true);
+
+    return _hashtable_get_value(table, spt_linkedlist_node_get_tuple(node));
+}
+
+// The stages of a lookup in hashtable_get_batch. Each names the item which was
+// prefetched when the lookup last yielded, and which it will read next. A node
+// and its tuple share an allocation, so they arrive together.
+typedef enum _hashtable_lookup_stage {
+    LOOKUP_BUCKET,
+    LOOKUP_NODE,
+    LOOKUP_KEY,
+    LOOKUP_IDLE
+} _hashtable_lookup_stage;
+
+typedef struct _hashtable_lookup {
+    _hashtable_lookup_stage stage;
+    uint32_t index;
+    unsigned long hash;
+    spt_linkedlist *bucket;
+    spt_linkedlist_node *node;
+} _hashtable_lookup;
+
+// Starts a lookup for the next key which the filter can't rule out. Returns 
+// false iff there were no such keys left.
+bool _hashtable_lookup_start(hashtable *table, _hashtable_lookup *lookup, char **keys, void **vals, uint32_t *next, uint32_t n) {
+    while (*next < n) {
+        uint32_t index = (*next)++;
+        unsigned long hash = _hashtable_get_hash(keys[index]);
+
+        if (!bloom_filter_might_contain(table->filter, hash)) {
+            vals[index] = NULL;
+            continue;
+        }
+
+        lookup->index = index;
+        lookup->hash = hash;
+        lookup->bucket = _hashtable_get_bucket_by_hash(table, hash);
+        lookup->node = NULL;
+        lookup->stage = LOOKUP_BUCKET;
+
+        __builtin_prefetch(lookup->bucket);
+        return true;
+    }
+
+    lookup->stage = LOOKUP_IDLE;
+    return false;
+}
+
+// Advances a lookup by one stage. Returns true iff the lookup has finished.
+bool _hashtable_lookup_step(hashtable *table, _hashtable_lookup *lookup, char **keys, void **vals, uint32_t *found) {
+    str_ptr_tuple *tuple;
+
+    switch (lookup->stage) {
+        case LOOKUP_BUCKET:
+            lookup->node = spt_linkedlist_get_head(lookup->bucket);
+            break;
+        case LOOKUP_NODE:
+            tuple = spt_linkedlist_node_get_tuple(lookup->node);
+
+            // Only fetch the key if the cached hash matches
+            if (str_ptr_tuple_get_hash(tuple) == lookup->hash) {
+                __builtin_prefetch(str_ptr_tuple_get_str(tuple));
+                lookup->stage = LOOKUP_KEY;
+                return false;
+            }
+            lookup->node = spt_linkedlist_node_get_next(lookup->node);
+            break;
+        case LOOKUP_KEY:
+            tuple = spt_linkedlist_node_get_tuple(lookup->node);
+            if (str_ptr_tuple_strcmp(tuple, keys[lookup->index])) {
+                // Other lookups may be partway along the same chain, so an
+                // expired entry is left for hashtable_expire to remove
+                if (_hashtable_is_expired(table, lookup->node)) {
+                    vals[lookup->index] = NULL;
+                    return true;
+                }
+
+                vals[lookup->index] = _hashtable_get_value(table, tuple);
+                _hashtable_set_referenced(lookup->node, true);
+                (*found)++;
+                return true;
+            }
+            lookup->node = spt_linkedlist_node_get_next(lookup->node);
+            break;
+        case LOOKUP_IDLE:
+            return false;
+    }
+
+    // MID: We have moved on to a new node, which is NULL at the end of a chain
+    if (!lookup->node) {
+        vals[lookup->index] = NULL;
+        bloom_filter_record_false_positive(table->filter);
+        return true;
+    }
+
+    __builtin_prefetch(lookup->node);
+    lookup->stage = LOOKUP_NODE;
+    return false;
+}
+
+uint32_t hashtable_get_batch(hashtable *table, char **keys, void **vals, uint32_t n) {
+    if (!table || !keys || !vals) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted a batch lookup with a null argument", "Returning 0");
+        return 0;
+    }
+
+    _hashtable_lookup lookups[HASHTABLE_BATCH_WIDTH];
+    uint32_t next = 0;
+    uint32_t in_flight = 0;
+    uint32_t found = 0;
+
+    for (int i = 0; i < HASHTABLE_BATCH_WIDTH; i++) {
+        if (_hashtable_lookup_start(table, lookups + i, keys, vals, &next, n)) {
+            in_flight++;
+        }
+    }
+
+    // Round-robin over the in-flight lookups. By the time we come back to a
+    // lookup, the item it prefetched should have arrived in cache.
+    while (in_flight > 0) {
+        for (int i = 0; i < HASHTABLE_BATCH_WIDTH; i++) {
+            _hashtable_lookup *lookup = lookups + i;
+
+            if (lookup->stage == LOOKUP_IDLE) continue;
+            if (!_hashtable_lookup_step(table, lookup, keys, vals, &found)) continue;
+
+            // MID: lookup has finished, so reuse its slot for the next key
+            if (!_hashtable_lookup_start(table, lookup, keys, vals, &next, n)) {
+                in_flight--;
+            }
+        }
+    }
+
+    table->hits += found;
+    table->misses += n - found;
+
+    return found;
+}
+
+typedef enum _hashtable_build_stage {
+    BUILD_HASH,
+    BUILD_SCATTER,
+    BUILD_FILL
+} _hashtable_build_stage;
+
+typedef struct _hashtable_build_task {
+    _hashtable_build_stage stage;
+    hashtable *table;
+    uint32_t nthreads;
+    char **keys;
+    void **values;
+    unsigned long *hashes;
+    uint32_t *order;
+    // The range of keys this task hashes and scatters
+    uint32_t begin;
+    uint32_t end;
+    // The range of order (one partition) whose entries this task links in
+    uint32_t part_begin;
+    uint32_t part_end;
+    // How many of this task's keys fall into each partition, which become the
+    // positions in order that it scatters them to
+    uint32_t offsets[HASHTABLE_MAX_THREADS];
+} _hashtable_build_task;
+
+// Returns the partition of the buckets that a hash falls into. Partitions are
+// whole ranges of pages, so no two threads write to the same page.
+uint32_t _hashtable_build_get_partition(hashtable *table, unsigned long hash, uint32_t nthreads) {
+    uint32_t page = (uint32_t) (hash % hashtable_get_capacity(table)) >> HASHTABLE_PAGE_BITS;
+    return (uint32_t) (((uint64_t) page * nthreads) / table->dir->page_count);
+}
+
+void *_hashtable_build_run(void *arg) {
+    _hashtable_build_task *task = arg;
+    hashtable *table = task->table;
+
+    switch (task->stage) {
+        case BUILD_HASH:
+            for (uint32_t i = task->begin; i < task->end; i++) {
+                task->hashes[i] = _hashtable_get_hash(task->keys[i]);
+                task->offsets[_hashtable_build_get_partition(table, task->hashes[i], task->nthreads)]++;
+            }
+            break;
+
+        case BUILD_SCATTER:
+            for (uint32_t i = task->begin; i < task->end; i++) {
+                task->order[task->offsets[_hashtable_build_get_partition(table, task->hashes[i], task->nthreads)]++] = i;
+            }
+            break;
+
+        case BUILD_FILL:
+            // Our partition's buckets are written by no other thread, and the
+            // hashtable is new so none of its pages are shared
+            for (uint32_t j = task->part_begin; j < task->part_end; j++) {
+                uint32_t i = task->order[j];
+                spt_linkedlist_node *node = spt_linkedlist_node_init_inline(task->keys[i], task->values[i], table->value_size);
+
+                str_ptr_tuple_set_hash(spt_linkedlist_node_get_tuple(node), task->hashes[i]);
+                spt_linkedlist_add(_hashtable_get_bucket_by_id(table, task->hashes[i] % hashtable_get_capacity(table)), node);
+            }
+            break;
+    }
+
+    return NULL;
+}
+
+hashtable *hashtable_build(char **keys, void **values, uint32_t n, uint32_t nthreads) {
+    if ((!keys || !values) && n > 0) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to build a hashtable from a null array", "Returning null");
+        return NULL;
+    }
+
+    // Presize the hashtable so that it never needs to grow while we fill it
+    hashtable *table = hashtable_init(n > 0 ? n : 1, true);
+    if (!table || n == 0) return table;
+
+    nthreads = _hashtable_get_thread_count(nthreads);
+
+    _hashtable_build_task *tasks = calloc(nthreads, sizeof(_hashtable_build_task));
+    unsigned long *hashes = malloc(n * sizeof(unsigned long));
+    uint32_t *order = malloc(n * sizeof(uint32_t));
+
+    for (uint32_t t = 0; t < nthreads; t++) {
+        tasks[t].stage = BUILD_HASH;
+        tasks[t].table = table;
+        tasks[t].nthreads = nthreads;
+        tasks[t].keys = keys;
+        tasks[t].values = values;
+        tasks[t].hashes = hashes;
+        tasks[t].order = order;
+        tasks[t].begin = (uint32_t) (((uint64_t) n * t) / nthreads);
+        tasks[t].end = (uint32_t) (((uint64_t) n * (t + 1)) / nthreads);
+    }
+
+    _hashtable_run_parallel(_hashtable_build_run, tasks, sizeof(_hashtable_build_task), nthreads);
+
+    // Turn the counts into the position each task scatters its first key of 
+    // each partition to. Partitions are laid out in order, and within each 
+    // partition the tasks' keys are in the order of the keys array.
+    uint32_t position = 0;
+    for (uint32_t p = 0; p < nthreads; p++) {
+        tasks[p].part_begin = position;
+
+        for (uint32_t t = 0; t < nthreads; t++) {
+            uint32_t count = tasks[t].offsets[p];
+            tasks[t].offsets[p] = position;
+            position += count;
+        }
+
+        tasks[p].part_end = position;
+    }
+
+    for (uint32_t t = 0; t < nthreads; t++) tasks[t].stage = BUILD_SCATTER;
+    _hashtable_run_parallel(_hashtable_build_run, tasks, sizeof(_hashtable_build_task), nthreads);
+
+    for (uint32_t t = 0; t < nthreads; t++) tasks[t].stage = BUILD_FILL;
+    _hashtable_run_parallel(_hashtable_build_run, tasks, sizeof(_hashtable_build_task), nthreads);
+
+    table->size = n;
+
+    free(order);
+    free(hashes);
+    free(tasks);
+
+    return table;
+}
+
+// Expands a dynamic hashtable until it can hold size entries without growing
+void _hashtable_reserve(hashtable *table, uint32_t size) {
+    while (hashtable_is_dynamic(table) && hashtable_get_capacity(table) < size) {
+        if (!hashtable_expand_and_rehash(table)) return;
+    }
+}
+
+// Finds the live node for a key without updating any counters, so that any 
+// number of threads may call it on the same hashtable at once
+spt_linkedlist_node *_hashtable_peek_node(hashtable *table, char *key, unsigned long hash) {
+    spt_linkedlist_node *node = spt_linkedlist_get_node_by_hashed_str(_hashtable_get_bucket_by_hash(table, hash), hash, key);
+
+    if (node && _hashtable_is_expired(table, node)) return NULL;
+    return node;
+}
+
+// Checks the arguments of an operation writing the entries of src into dest
+bool _hashtable_can_write_all(hashtable *dest, hashtable *src, const char *func) {
+    if (!dest || !src) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, func, "Attempted to combine a null hashtable", "Returning false");
+        return false;
+    }
+
+    if (dest->is_snapshot) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, func, "Attempted to write to a snapshot", "Returning false");
+        return false;
+    }
+
+    if (dest->value_size != src->value_size) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, func, "Attempted to combine hashtables with different value sizes", "Returning false");
+        return false;
+    }
+
+    return true;
+}
+
+// Upserts every entry of src into dest, calling fn (if any) to combine the 
+// values of keys in both. Else the value from src replaces the value in dest.
+bool _hashtable_write_all(hashtable *dest, hashtable *src, hashtable_merge_fn fn, void *ctx) {
+    // Presize for every key of src being new, so that dest never rehashes 
+    // part-way through
+    uint64_t size = (uint64_t) hashtable_get_size(dest) + hashtable_get_size(src);
+    _hashtable_reserve(dest, size > UINT32_MAX ? UINT32_MAX : (uint32_t) size);
+
+    bool is_complete = true;
+
+    for (uint32_t i = 0; i < hashtable_get_capacity(src); i++) {
+        for (spt_linkedlist_node *curr = spt_linkedlist_get_head(_hashtable_get_bucket_by_id(src, i)); curr; curr = spt_linkedlist_node_get_next(curr)) {
+            if (_hashtable_is_expired(src, curr)) continue;
+
+            str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(curr);
+            char *key = str_ptr_tuple_get_str(tuple);
+            void *val = _hashtable_get_value(src, tuple);
+
+            bool is_inserted;
+            spt_linkedlist *bucket;
+            spt_linkedlist_node *prev;
+
+            // Reuse the hash cached in src's entry rather than hashing again
+            spt_linkedlist_node *node = _hashtable_upsert_node(dest, key, str_ptr_tuple_get_hash(tuple), val, &is_inserted, &bucket, &prev);
+            if (!node) {
+                is_complete = false;
+                continue;
+            }
+
+            if (!is_inserted) {
+                str_ptr_tuple *dest_tuple = spt_linkedlist_node_get_tuple(node);
+                void *dest_val = _hashtable_get_value(dest, dest_tuple);
+
+                if (fn) val = fn(key, dest_val, val, ctx);
+
+                // An inline merge may have updated dest's value in place
+                if (val != dest_val) _hashtable_set_value(dest, dest_tuple, val);
+            }
+
+            _hashtable_grow(dest);
+        }
+    }
+
+    return is_complete;
+}
+
+bool hashtable_put_all(hashtable *dest, hashtable *src) {
+    if (!_hashtable_can_write_all(dest, src, __func__)) return false;
+
+    // Every key of a hashtable is already in it with its own value
+    if (dest == src) return true;
+
+    return _hashtable_write_all(dest, src, NULL, NULL);
+}
+
+bool hashtable_merge(hashtable *dest, hashtable *src, hashtable_merge_fn fn, void *ctx) {
+    if (!_hashtable_can_write_all(dest, src, __func__)) return false;
+
+    if (!fn) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to merge with a null function", "Returning false");
+        return false;
+    }
+
+    // Merging a hashtable into itself combines each value with itself, which is
+    // left to fn, but must not insert into the buckets being walked
+    if (dest == src) {
+        for (uint32_t i = 0; i < hashtable_get_capacity(dest); i++) {
+            spt_linkedlist *bucket = _hashtable_get_bucket_for_write(dest, i, NULL);
+
+            for (spt_linkedlist_node *curr = spt_linkedlist_get_head(bucket); curr; curr = spt_linkedlist_node_get_next(curr)) {
+                if (_hashtable_is_expired(dest, curr)) continue;
+
+                str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(curr);
+                void *val = _hashtable_get_value(dest, tuple);
+                void *merged = fn(str_ptr_tuple_get_str(tuple), val, val, ctx);
+
+                if (merged != val) _hashtable_set_value(dest, tuple, merged);
+            }
+        }
+        return true;
+    }
+
+    return _hashtable_write_all(dest, src, fn, ctx);
+}
+
+typedef struct _hashtable_filter_task {
+    hashtable *result;
+    hashtable *table;
+    hashtable *other;
+    bool is_intersect;
+    uint32_t begin;
+    uint32_t end;
+    uint32_t size;
+} _hashtable_filter_task;
+
+void *_hashtable_filter_run(void *arg) {
+    _hashtable_filter_task *task = arg;
+
+    for (uint32_t i = task->begin; i < task->end; i++) {
+        // The result has the same capacity as table, so each entry stays in the
+        // same bucket id, and no other task writes to it
+        spt_linkedlist *dest = _hashtable_get_bucket_by_id(task->result, i);
+
+        for (spt_linkedlist_node *curr = spt_linkedlist_get_head(_hashtable_get_bucket_by_id(task->table, i)); curr; curr = spt_linkedlist_node_get_next(curr)) {
+            if (_hashtable_is_expired(task->table, curr)) continue;
+
+            str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(curr);
+            bool is_in_other = _hashtable_peek_node(task->other, str_ptr_tuple_get_str(tuple), str_ptr_tuple_get_hash(tuple)) != NULL;
+
+            if (is_in_other == task->is_intersect) {
+                spt_linkedlist_add(dest, _hashtable_copy_node(task->table, task->result, curr));
+                task->size++;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Makes a new hashtable of the entries of table whose keys are (or, if not 
+// is_intersect, are not) in other
+hashtable *_hashtable_filter_keys(hashtable *table, hashtable *other, bool is_intersect, uint32_t nthreads) {
+    hashtable *result = hashtable_init_inline(hashtable_get_capacity(table), hashtable_is_dynamic(table), table->value_size);
+
+    // Split the buckets into whole pages, so that no two tasks write to a page
+    nthreads = _hashtable_get_thread_count(nthreads);
+    if (nthreads > result->dir->page_count) nthreads = result->dir->page_count;
+
+    _hashtable_filter_task tasks[HASHTABLE_MAX_THREADS];
+    for (uint32_t t = 0; t < nthreads; t++) {
+        uint64_t page_begin = ((uint64_t) result->dir->page_count * t) / nthreads;
+        uint64_t page_end = ((uint64_t) result->dir->page_count * (t + 1)) / nthreads;
+
+        tasks[t].result = result;
+        tasks[t].table = table;
+        tasks[t].other = other;
+        tasks[t].is_intersect = is_intersect;
+        tasks[t].begin = (uint32_t) (page_begin << HASHTABLE_PAGE_BITS);
+        tasks[t].end = (uint32_t) ((page_end << HASHTABLE_PAGE_BITS) < hashtable_get_capacity(table) ? (page_end << HASHTABLE_PAGE_BITS) : hashtable_get_capacity(table));
+        tasks[t].size = 0;
+    }
+
+    _hashtable_run_parallel(_hashtable_filter_run, tasks, sizeof(_hashtable_filter_task), nthreads);
+
+    for (uint32_t t = 0; t < nthreads; t++) {
+        result->size += tasks[t].size;
+    }
+
+    return result;
+}
+
+hashtable *hashtable_intersect(hashtable *a, hashtable *b, uint32_t nthreads) {
+    if (!a || !b) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to intersect a null hashtable", "Returning null");
+        return NULL;
+    }
+
+    return _hashtable_filter_keys(a, b, true, nthreads);
+}
+
+hashtable *hashtable_difference(hashtable *a, hashtable *b, uint32_t nthreads) {
+    if (!a || !b) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to take the difference of a null hashtable", "Returning null");
+        return NULL;
+    }
+
+    return _hashtable_filter_keys(a, b, false, nthreads);
+}
+
+hashtable *hashtable_snapshot(hashtable *table) {
+    if (!table) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to take a snapshot of a null hashtable", "Returning null");
+        return NULL;
+    }
+
+    hashtable *snapshot = calloc(1, sizeof(hashtable));
+
+    snapshot->capacity = table->capacity;
+    snapshot->size = table->size;
+    snapshot->is_dynamic = table->is_dynamic;
+    snapshot->is_snapshot = true;
+    snapshot->value_size = table->value_size;
+
+    // The only O(1) step: the pages are shared until the hashtable writes to
+    // them, at which point it copies the directory and then the page
+    __atomic_add_fetch(&table->dir->refcount, 1, __ATOMIC_ACQ_REL);
+    snapshot->dir = table->dir;
+
+    return snapshot;
+}
+
+hashtable *hashtable_clone_deep(hashtable *table) {
+    if (!table) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to clone a null hashtable", "Returning null");
+        return NULL;
+    }
+
+    hashtable *clone = hashtable_init(hashtable_get_capacity(table), hashtable_is_dynamic(table));
+
+    clone->size = table->size;
+    clone->value_size = table->value_size;
+    clone->max_entries = table->max_entries;
+    clone->on_evict = table->on_evict;
+    clone->evict_ctx = table->evict_ctx;
+
+    if (table->wheel) {
+        clone->wheel = timing_wheel_init(table->wheel->now);
+    }
+
+    // Copy whole pages. The pages of a fresh hashtable are empty, so we replace
+    // them rather than adding to them.
+    for (uint32_t i = 0; i < clone->dir->page_count; i++) {
+        _hashtable_release_page(clone->dir->pages[i]);
+        clone->dir->pages[i] = _hashtable_copy_page(table, clone, table->dir->pages[i], NULL);
+    }
+
+    if (table->filter) {
+        hashtable_enable_filter(clone, table->filter->bits_per_item);
+    }
+
+    if (table->front) {
+        hashtable_enable_front_cache(clone, table->front_size);
+    }
+
+    return clone;
+}
+
+void hashtable_for_each(hashtable *table, hashtable_visit_fn fn, void *ctx) {
+    if (!table || !fn) return;
+
+    for (uint32_t i = 0; i < hashtable_get_capacity(table); i++) {
+        spt_linkedlist_node *curr = spt_linkedlist_get_head(_hashtable_get_bucket_by_id(table, i));
+
+        while (curr) {
+            // Read next first, so that fn may remove the entry it is given
+            spt_linkedlist_node *next = spt_linkedlist_node_get_next(curr);
+            str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(curr);
+
+            if (!_hashtable_is_expired(table, curr)) {
+                fn(str_ptr_tuple_get_str(tuple), _hashtable_get_value(table, tuple), ctx);
+            }
+
+            curr = next;
+        }
+    }
+}
+
+void *hashtable_clone(hashtable *table) {
+    uint32_t capacity = hashtable_get_capacity(table);
+    bool is_dynamic = hashtable_is_dynamic(table);
+
+    return hashtable_init(capacity, is_dynamic);
+}
+
+void hashtable_clear(hashtable *table) {
+    // Cuts from the loop early
+    if (!table) return;
+    if (table->is_snapshot) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to clear a snapshot", "Snapshot is unchanged");
+        return;
+    }
+
+    // Releasing the pages destroys the nodes in them, unless they are still 
+    // shared with a snapshot
+    timing_wheel_clear(table->wheel);
+    _hashtable_release_dir(table->dir);
+    table->dir = _hashtable_dir_init(hashtable_get_capacity(table));
+
+    table->size = 0;
+    bloom_filter_clear(table->filter);
+    table->filter_stale = 0;
+    _hashtable_front_clear(table);
+}
+
+void hashtable_destroy(hashtable *table) {
+    if (!table) return;
+
+    timing_wheel_destroy(table->wheel);
+    hashtable_disable_filter(table);
+    hashtable_disable_front_cache(table);
+    _hashtable_release_dir(table->dir);
 
-    free(table->buckets);
     free(table);
 }
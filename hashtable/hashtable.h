@@ -14,6 +14,25 @@
  */
 unsigned long _hashtable_get_hash(char *str);
 
+/* Returns the hash of a key, as used by every hashtable. Since all hashtables 
+ * hash keys the same way, a key looking up several hashtables only needs to be
+ * hashed once, and then passed to the _with_hash functions.
+ *
+ * @param key The key to get the hash of
+ * @return    The hash of key
+ */
+unsigned long hashtable_hash(char *key);
+
+/* Maps the hash of a key to one of a number of shards. The shard is taken from
+ * different bits of the hash than the bucket id, so that the keys of each shard
+ * are still spread over all of its buckets.
+ *
+ * @param hash        The hash of a key, from hashtable_hash
+ * @param shard_count The number of shards
+ * @return            The shard for the key, in [0, shard_count)
+ */
+uint32_t hashtable_hash_to_shard(unsigned long hash, uint32_t shard_count);
+
 /* Creates an initialized hashtable in memory
  * Iff is_dynamic set, the capacity will increase automatically when items are
  * added to the hashtable. 
@@ -24,21 +43,42 @@ unsigned long _hashtable_get_hash(char *str);
  * @param is_dynamic True iff the hashtable 
  * @return           A pointer to initialized hashtable's location in memory
  */
-hashtable *hashtable_init(uint16_t capacity, bool is_dynamic);
+hashtable *hashtable_init(uint32_t capacity, bool is_dynamic);
+
+/* Creates an initialized hashtable in memory whose values are stored inline. 
+ * Each entry is a single allocation holding the key pointer, its hash and a 
+ * copy of the value, so gets return a pointer into the entry rather than a 
+ * separately allocated value. Entries are cache-line aligned, and an entry 
+ * with a value of up to 24 bytes fits in a single 64-byte line.
+ *
+ * @param capacity   The initial capacity of the hashtable. 
+ * @param is_dynamic True iff the hashtable's capacity should grow as needed
+ * @param value_size The size in bytes of every value in the hashtable
+ * @return           A pointer to initialized hashtable's location in memory
+ */
+hashtable *hashtable_init_inline(uint32_t capacity, bool is_dynamic, uint32_t value_size);
+
+/* Returns the size of the values stored inline in a hashtable
+ *
+ * @param hashtable The hashtable for which to find the value size
+ * @return          The size in bytes of the hashtable's inline values, or 0 if 
+ *                  it stores void * values
+ */
+uint32_t hashtable_get_value_size(hashtable *table);
 
 /* Returns the hashtable's number of elements
  *
  * @param hashtable The hashtable for which to find the size
  * @return          The size of the hashtable parameter
  */
-uint16_t hashtable_get_size(hashtable *table);
+uint32_t hashtable_get_size(hashtable *table);
 
 /* Returns the hashtable's max possible number of elements
  *
  * @param hashtable The hashtable for which to find the capacity
  * @return          The capacity of the hashtable parameter
  */
-uint16_t hashtable_get_capacity(hashtable *table);
+uint32_t hashtable_get_capacity(hashtable *table);
 
 /* Returns true iff the input hashtable is dynamic
  *
@@ -62,16 +102,111 @@ bool hashtable_is_empty(hashtable *table);
  */
 bool hashtable_contains_key(hashtable *table, char *key);
 
-/* Adds a key-value pair to a hashtable
+/* As hashtable_contains_key, for a key whose hash has already been computed
+ *
+ * @param hashtable The hashtable to perform the check on
+ * @param key       The key that is being checked for within the hashtable
+ * @param hash      The hash of key, from hashtable_hash
+ * @return          True iff hashtable contains the key, else returns false
+ */
+bool hashtable_contains_key_with_hash(hashtable *table, char *key, unsigned long hash);
+
+/* Adds a key-value pair to a hashtable. If the hashtable is in cache mode and 
+ * at its budget, an entry is evicted to make room.
  *
  * @param hashtable A pointer in memory to the hashtable to add the values to
  * @param key       The key to add to the hashtable
- * @param value     The value to associate with the key added
+ * @param value     The value to associate with the key added. For an inline
+ *                  hashtable, the value_size bytes it points to are copied, or
+ *                  zero-filled if it is NULL.
  * @return          True iff the key and value were successfully added to the 
  *                  hashtable. Else false.
  */
 bool hashtable_add(hashtable *table, char *key, void *value);
 
+/* As hashtable_add, for a key whose hash has already been computed
+ *
+ * @param hashtable A pointer in memory to the hashtable to add the values to
+ * @param key       The key to add to the hashtable
+ * @param value     The value to associate with the key added
+ * @param hash      The hash of key, from hashtable_hash
+ * @return          True iff the key and value were successfully added to the 
+ *                  hashtable. Else false.
+ */
+bool hashtable_add_with_hash(hashtable *table, char *key, void *value, unsigned long hash);
+
+/* Adds a key-value pair to a hashtable which expires after a time to live. An 
+ * expired entry is never returned: gets remove it lazily, and each add and get
+ * also removes up to HASHTABLE_EXPIRE_STEP entries which have expired.
+ *
+ * @param hashtable A pointer in memory to the hashtable to add the values to
+ * @param key       The key to add to the hashtable
+ * @param value     The value to associate with the key added
+ * @param ttl_ms    The number of milliseconds after which the entry expires. 
+ *                  Zero means the entry never expires, as with hashtable_add.
+ * @return          True iff the key and value were successfully added to the 
+ *                  hashtable. Else false.
+ */
+bool hashtable_add_with_ttl(hashtable *table, char *key, void *value, uint64_t ttl_ms);
+
+/* Removes entries whose time to live has passed from a hashtable. The cost is
+ * proportional to the number of entries expired, not the size of the table.
+ *
+ * @param table           The hashtable to remove expired entries from
+ * @param max_expirations The most entries to remove in this call
+ * @return                The number of entries which were removed
+ */
+uint32_t hashtable_expire(hashtable *table, uint32_t max_expirations);
+
+/* Adds a key-value pair to a hashtable, replacing the value of the key if it is
+ * already present. Hashes the key once and walks its bucket once. An entry 
+ * which is replaced keeps its TTL.
+ *
+ * @param table A pointer in memory to the hashtable to put the values in
+ * @param key   The key to put in the hashtable
+ * @param value The value to associate with the key, copied as by hashtable_add
+ *              for an inline hashtable
+ * @return      True iff the key is associated with value in the hashtable
+ */
+bool hashtable_put(hashtable *table, char *key, void *value);
+
+/* Returns the value slot of a key in a hashtable, first adding the key with the
+ * given value if it is absent. Hashes the key once and walks its bucket once.
+ *
+ * @param table    The hashtable to find or insert the key in
+ * @param key      The key to find or insert
+ * @param value    The value to insert the key with if it is absent
+ * @param inserted If not NULL, set to true iff the key was inserted
+ * @return         A pointer to the key's value slot: the value itself in an 
+ *                 inline hashtable, else a void ** to the entry's value 
+ *                 pointer. NULL if the key was absent and couldn't be added.
+ */
+void *hashtable_find_or_insert(hashtable *table, char *key, void *value, bool *inserted);
+
+/* As hashtable_find_or_insert, for a key whose hash has already been computed
+ *
+ * @param table    The hashtable to find or insert the key in
+ * @param key      The key to find or insert
+ * @param value    The value to insert the key with if it is absent
+ * @param hash     The hash of key, from hashtable_hash
+ * @param inserted If not NULL, set to true iff the key was inserted
+ * @return         A pointer to the key's value slot, as hashtable_find_or_insert
+ */
+void *hashtable_find_or_insert_with_hash(hashtable *table, char *key, void *value, unsigned long hash, bool *inserted);
+
+/* Updates the value of a key in a hashtable in place, inserting the key with a
+ * zero-filled (or NULL) value first if it is absent. Hashes the key once and 
+ * walks its bucket once.
+ *
+ * @param table The hashtable holding the key
+ * @param key   The key whose value to compute
+ * @param fn    Called on the key's value slot. If it returns false, the entry 
+ *              is removed.
+ * @param ctx   Passed through to fn
+ * @return      True iff the key is in the hashtable after the call
+ */
+bool hashtable_compute(hashtable *table, char *key, hashtable_compute_fn fn, void *ctx);
+
 /* Removes a key and its associated value from a hashtable
  *
  * @param hashtable A pointer in memory to the hashtable to remove the key and
@@ -82,15 +217,136 @@ bool hashtable_add(hashtable *table, char *key, void *value);
  */
 bool hashtable_remove(hashtable *table, char *key);
 
+/* As hashtable_remove, for a key whose hash has already been computed
+ *
+ * @param hashtable The hashtable to remove the key from
+ * @param key       The key to remove from the hashtable
+ * @param hash      The hash of key, from hashtable_hash
+ * @return          True iff the key (and associated value) was successfully 
+ *                  removed from the hashtable
+ */
+bool hashtable_remove_with_hash(hashtable *table, char *key, unsigned long hash);
+
 /* Returns the value associated with a key in a given hashtable
  *
  * @param hashtable The hashtable in which to look up the key and return a value
  *                  from
  * @param key       The key to look up in the hashtable
- * @return          The value associated with a key in a given hashtable
+ * @return          The value associated with a key in a given hashtable. For an
+ *                  inline hashtable, a pointer to the value within the entry, 
+ *                  valid until the entry is removed or, while the hashtable 
+ *                  has a snapshot, until the hashtable is next written to.
  */ 
 void *hashtable_get(hashtable *table, char *key);
 
+/* As hashtable_get, for a key whose hash has already been computed
+ *
+ * @param hashtable The hashtable in which to look up the key
+ * @param key       The key to look up in the hashtable
+ * @param hash      The hash of key, from hashtable_hash
+ * @return          The value associated with a key in a given hashtable
+ */ 
+void *hashtable_get_with_hash(hashtable *table, char *key, unsigned long hash);
+
+/* Looks up a batch of keys in a hashtable, interleaving the lookups so that the
+ * cache misses of up to HASHTABLE_BATCH_WIDTH of them are in flight at once.
+ * Each lookup prefetches the next thing it needs (bucket, node, tuple, key) and
+ * yields to the others rather than stalling on the miss.
+ *
+ * @param table The hashtable in which to look up the keys
+ * @param keys  An array of n keys to look up in the hashtable
+ * @param vals  An array of n slots. vals[i] is set to the value associated with
+ *              keys[i], or NULL if keys[i] is not in the hashtable
+ * @param n     The number of keys to look up
+ * @return      The number of keys which were found in the hashtable
+ */
+uint32_t hashtable_get_batch(hashtable *table, char **keys, void **vals, uint32_t n);
+
+/* Builds a dynamic hashtable holding n entries, as if each keys[i], values[i] 
+ * had been added in turn with hashtable_add, but using up to nthreads threads. 
+ * The hashtable is presized so that it never rehashes. Keys are hashed in 
+ * parallel, then partitioned by the range of buckets they fall into, so that 
+ * each thread fills its own buckets without any locking.
+ *
+ * @param keys     An array of n non-null keys
+ * @param values   An array of n values, values[i] being associated with keys[i]
+ * @param n        The number of entries to build the hashtable from
+ * @param nthreads The number of threads to use, at most HASHTABLE_MAX_THREADS
+ * @return         A pointer to the new hashtable, or null if it couldn't be 
+ *                 built
+ */
+hashtable *hashtable_build(char **keys, void **values, uint32_t n, uint32_t nthreads);
+
+/* Takes a read-only snapshot of a hashtable in O(1). The snapshot shares the 
+ * hashtable's pages of buckets, and the hashtable copies a page only when it 
+ * first writes to it, so the snapshot can be read (e.g. from another thread)
+ * while the hashtable keeps serving writes. Snapshots have no filter, cache mode
+ * or TTLs of their own. Destroy them with hashtable_destroy.
+ *
+ * @param table The hashtable to take a snapshot of
+ * @return      A pointer to the snapshot, or NULL if table is NULL
+ */
+hashtable *hashtable_snapshot(hashtable *table);
+
+/* Makes a deep copy of the current hashtable, including all of its elements, 
+ * its filter, its cache mode and the TTLs of its entries. Keys and values are 
+ * shared with the input hashtable rather than copied.
+ *
+ * @param hashtable The hashtable to make a copy of
+ * @return          A pointer to the new hashtable copy
+ */
+hashtable *hashtable_clone_deep(hashtable *table);
+
+/* Calls a function on every entry in a hashtable, in bucket order
+ *
+ * @param table The hashtable to iterate over
+ * @param fn    The function to call on each entry
+ * @param ctx   Passed through to fn
+ */
+void hashtable_for_each(hashtable *table, hashtable_visit_fn fn, void *ctx);
+
+/* Puts every entry of src into dest, replacing the values of keys already in 
+ * dest. dest is presized for src, and the hashes cached in src's entries are 
+ * reused rather than recomputed.
+ *
+ * @param dest The hashtable to put the entries into
+ * @param src  The hashtable whose entries are put into dest
+ * @return     True iff every entry of src was put into dest
+ */
+bool hashtable_put_all(hashtable *dest, hashtable *src);
+
+/* Puts every entry of src into dest as hashtable_put_all, except that the value
+ * of a key already in dest becomes the result of calling fn on both values
+ *
+ * @param dest The hashtable to merge the entries into
+ * @param src  The hashtable whose entries are merged into dest
+ * @param fn   The function combining the values of keys in both hashtables
+ * @param ctx  Passed through to fn
+ * @return     True iff every entry of src was merged into dest
+ */
+bool hashtable_merge(hashtable *dest, hashtable *src, hashtable_merge_fn fn, void *ctx);
+
+/* Makes a new hashtable of the entries of a whose keys are also in b. The new 
+ * hashtable has the capacity of a, so each entry keeps its bucket, and ranges of
+ * buckets are filled on up to nthreads threads without locking.
+ *
+ * @param a        The hashtable whose entries are kept
+ * @param b        The hashtable whose keys are looked up
+ * @param nthreads The number of threads to use, at most HASHTABLE_MAX_THREADS
+ * @return         A pointer to the new hashtable, or NULL if a or b is NULL
+ */
+hashtable *hashtable_intersect(hashtable *a, hashtable *b, uint32_t nthreads);
+
+/* Makes a new hashtable of the entries of a whose keys are not in b, in the same
+ * way as hashtable_intersect
+ *
+ * @param a        The hashtable whose entries are kept
+ * @param b        The hashtable whose keys are looked up
+ * @param nthreads The number of threads to use, at most HASHTABLE_MAX_THREADS
+ * @return         A pointer to the new hashtable, or NULL if a or b is NULL
+ */
+hashtable *hashtable_difference(hashtable *a, hashtable *b, uint32_t nthreads);
+
 /* Makes a soft-copy of the currenct hashtable. The new hashtable will have the 
  * same capacity and properties as the input hashtable, but none of the elements
  * within it.
@@ -116,13 +372,87 @@ void hashtable_clear(hashtable *table);
 
 bool hashtable_expand_and_rehash(hashtable *table);
 
+/* Doubles the capacity of a hashtable, as hashtable_expand_and_rehash, but 
+ * rehashing ranges of the old buckets on up to nthreads threads. Each old 
+ * bucket i can only map to new bucket i or i + old capacity, so the threads 
+ * write to disjoint buckets and need no locking.
+ *
+ * @param hashtable The hashtable to resize
+ * @param nthreads  The number of threads to use, at most HASHTABLE_MAX_THREADS
+ * @return          True iff the hashtable was resized
+ */
+bool hashtable_expand_and_rehash_parallel(hashtable *table, uint32_t nthreads);
+
+/* Puts a blocked bloom filter in front of the hashtable's buckets, so that most
+ * lookups for absent keys cost one cache line and no key comparisons. The 
+ * filter is maintained by adds and removes, and rebuilt when the hashtable is
+ * resized. Enabling the filter on a hashtable which already has one rebuilds it.
+ *
+ * @param table        The hashtable to put the filter in front of
+ * @param bits_per_key The number of filter bits per key of capacity. 10 bits
+ *                     gives a false-positive rate of around 1%.
+ * @return             True iff the filter was successfully enabled
+ */
+bool hashtable_enable_filter(hashtable *table, uint8_t bits_per_key);
+
+/* Removes and frees the filter in front of a hashtable's buckets, if it has one
+ *
+ * @param table The hashtable to remove the filter from
+ */
+void hashtable_disable_filter(hashtable *table);
+
+/* Puts a small direct-mapped cache of recently found keys in front of the 
+ * buckets, for workloads where a few keys take most of the gets. A get which 
+ * hits the cache skips the bucket walk. A get which misses fills the cache, and
+ * moves the key's entry to the head of its bucket if no snapshot shares it. 
+ * Enabling the cache on a hashtable which already has one empties it.
+ *
+ * @param table   The hashtable to put the cache in front of
+ * @param entries The number of entries in the cache. A few thousand keep it 
+ *                within L1/L2.
+ * @return        True iff the cache was successfully enabled
+ */
+bool hashtable_enable_front_cache(hashtable *table, uint32_t entries);
+
+/* Removes and frees the front cache of a hashtable, if it has one
+ *
+ * @param table The hashtable to remove the front cache from
+ */
+void hashtable_disable_front_cache(hashtable *table);
+
+/* Puts a hashtable into cache mode, where adds beyond a budget of entries evict
+ * existing ones rather than failing. Victims are chosen by CLOCK, an 
+ * approximation of LRU: gets set a reference bit on their entry, and a hand 
+ * sweeping the buckets evicts the first entry whose bit is unset, clearing the 
+ * bits it passes over.
+ *
+ * @param table       The hashtable to put into cache mode
+ * @param max_entries The maximum number of entries to hold. Zero turns cache 
+ *                    mode off. If the hashtable already holds more, the excess
+ *                    is evicted immediately.
+ * @param on_evict    Called on each evicted or expired entry before it is 
+ *                    destroyed. May be NULL. It is kept when cache mode is 
+ *                    turned off.
+ * @param ctx         Passed through to on_evict
+ * @return            True iff the hashtable's cache mode was set
+ */
+bool hashtable_set_cache_mode(hashtable *table, uint32_t max_entries, hashtable_evict_fn on_evict, void *ctx);
+
+/* Returns the counters kept by a hashtable
+ *
+ * @param table The hashtable to get the counters of
+ * @return      A snapshot of the hashtable's counters. All zero if table is 
+ *              NULL
+ */
+hashtable_stats hashtable_get_stats(hashtable *table);
+
 /* Returns the id of the bucket for which the input string is the key.
  *
  * @param table The hashtable to search for the bucket in
  * @param str   The key of the bucket whose id we want to get
  * @return      The id of the bucket for which str is the key
  */
-uint16_t hashtable_get_bucket_id(hashtable *table, char *str);
+uint32_t hashtable_get_bucket_id(hashtable *table, char *str);
 
 /* Returns the bucket for which the input string is the key.
  *
@@ -2,14 +2,179 @@
 #define HASHTABLE_STRUCT_H
 
 #include "spt_linkedlist/spt_linkedlist.h"
+#include "bloom_filter/bloom_filter.h"
+#include "timing_wheel/timing_wheel.h"
 
 #define MAX_STRING_LEN 256
 
+// The number of lookups hashtable_get_batch keeps in flight at once
+#define HASHTABLE_BATCH_WIDTH 16
+
+// The buckets of a hashtable are split into pages of 2^HASHTABLE_PAGE_BITS 
+// buckets, which are the unit of copy-on-write between a hashtable and its 
+// snapshots
+#define HASHTABLE_PAGE_BITS 6
+#define HASHTABLE_PAGE_SIZE (1 << HASHTABLE_PAGE_BITS)
+
+// The most expired entries each add or get removes from a hashtable with TTLs,
+// spreading the cost of expiry across operations
+#define HASHTABLE_EXPIRE_STEP 4
+
+// The most threads a parallel hashtable operation will use
+#define HASHTABLE_MAX_THREADS 64
+
+/* Called on each entry a cache-mode hashtable evicts, before it is destroyed, so
+ * that the caller can release the key and value
+ *
+ * @param key The key of the evicted entry
+ * @param val The value of the evicted entry
+ * @param ctx The context pointer passed to hashtable_set_cache_mode
+ */
+typedef void (*hashtable_evict_fn)(char *key, void *val, void *ctx);
+
+/* Called by hashtable_compute on the value slot of an entry, to update it in 
+ * place
+ *
+ * @param key    The key of the entry
+ * @param slot   A pointer to the entry's value: the value itself in an inline 
+ *               hashtable, else a void ** to the entry's value pointer
+ * @param is_new True iff the entry was inserted for this call, in which case 
+ *               the value is zero-filled (or NULL)
+ * @param ctx    The context pointer passed to hashtable_compute
+ * @return       True to keep the entry, or false to remove it
+ */
+typedef bool (*hashtable_compute_fn)(char *key, void *slot, bool is_new, void *ctx);
+
+/* Called on each entry visited by hashtable_for_each
+ *
+ * @param key The key of the entry
+ * @param val The value of the entry
+ * @param ctx The context pointer passed to hashtable_for_each
+ */
+typedef void (*hashtable_visit_fn)(char *key, void *val, void *ctx);
+
+/* Called by hashtable_merge on each key present in both hashtables, to combine
+ * their values
+ *
+ * @param key      The key of the entry
+ * @param dest_val The entry's value in the destination hashtable
+ * @param src_val  The entry's value in the source hashtable
+ * @param ctx      The context pointer passed to hashtable_merge
+ * @return         The value to store for the key in the destination hashtable
+ */
+typedef void *(*hashtable_merge_fn)(char *key, void *dest_val, void *src_val, void *ctx);
+
+/* A page of buckets, shared between a hashtable and its snapshots until one of
+ * them writes to it
+ *
+ * @elem refcount The number of page directories referring to the page
+ * @elem buckets  The buckets in the page
+ */
+typedef struct hashtable_page {
+    uint32_t refcount;
+    spt_linkedlist buckets[HASHTABLE_PAGE_SIZE];
+} hashtable_page;
+
+/* The directory of a hashtable's pages, itself shared with the hashtable's 
+ * snapshots so that taking one is O(1)
+ *
+ * @elem refcount   The number of hashtables referring to the directory
+ * @elem page_count The number of pages in the directory
+ * @elem pages      The pages, in order of the bucket ids they hold
+ */
+typedef struct hashtable_page_dir {
+    uint32_t refcount;
+    uint32_t page_count;
+    hashtable_page *pages[];
+} hashtable_page_dir;
+
+/* An entry of a hashtable's front cache, remembering the node of a recently 
+ * found key
+ *
+ * @elem hash The hash of the key
+ * @elem key  The key, as stored in the node
+ * @elem node The node holding the key, or NULL if the entry is empty
+ */
+typedef struct hashtable_front_entry {
+    unsigned long hash;
+    char *key;
+    spt_linkedlist_node *node;
+} hashtable_front_entry;
+
 typedef struct hashtable {
-    uint16_t capacity;
-    uint16_t size;
-    spt_linkedlist* buckets;
+    uint32_t capacity;
+    uint32_t size;
+    hashtable_page_dir *dir;
     bool is_dynamic;
+
+    // Snapshots share their pages with the hashtable they were taken from, and
+    // are read-only
+    bool is_snapshot;
+
+    // The size in bytes of the values stored inline in the hashtable's entries,
+    // or zero if it stores caller-owned void * values
+    uint32_t value_size;
+
+    // Optional filter consulted before the buckets. filter_stale counts the
+    // keys removed since it was last built, whose bits are still set.
+    bloom_filter *filter;
+    uint32_t filter_stale;
+
+    // Cache mode, which is off while max_entries is zero. clock_hand is the 
+    // bucket at which the next CLOCK eviction sweep starts.
+    uint32_t max_entries;
+    uint32_t clock_hand;
+    hashtable_evict_fn on_evict;
+    void *evict_ctx;
+
+    // Expiry timers of the entries added with a TTL, in milliseconds. NULL
+    // until the first such entry is added.
+    timing_wheel *wheel;
+
+    // Optional direct-mapped cache of the nodes of recently found keys, checked
+    // by gets before the buckets. Cleared whenever the hashtable copies a page,
+    // since that moves its nodes.
+    hashtable_front_entry *front;
+    uint32_t front_size;
+    uint64_t front_hits;
+    uint64_t front_misses;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t expirations;
 } hashtable;
 
+/* A snapshot of the counters kept by a hashtable
+ *
+ * @elem filter_queries             The number of lookups which consulted the 
+ *                                  hashtable's filter
+ * @elem filter_false_positives     The number of those lookups which the filter
+ *                                  failed to rule out, but which missed
+ * @elem filter_false_positive_rate The fraction of lookups for absent keys that
+ *                                  the filter failed to rule out
+ * @elem hits                       The number of gets which found their key
+ * @elem misses                     The number of gets which didn't
+ * @elem evictions                  The number of entries evicted in cache mode
+ * @elem expirations                The number of entries removed by their TTL
+ * @elem front_hits                 The number of gets answered by the front 
+ *                                  cache
+ * @elem front_misses               The number of gets which missed the front 
+ *                                  cache, and so walked a bucket
+ * @elem front_hit_rate             The fraction of gets answered by the front
+ *                                  cache
+ */
+typedef struct hashtable_stats {
+    uint64_t filter_queries;
+    uint64_t filter_false_positives;
+    double filter_false_positive_rate;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t expirations;
+    uint64_t front_hits;
+    uint64_t front_misses;
+    double front_hit_rate;
+} hashtable_stats;
+
 #endif 
@@ -0,0 +1,180 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hashtable_tsv.h"
+#include "../../crash_test/err/err.h"
+
+// Maps a whole file read-only. Sets data to NULL for an empty file, which mmap
+// refuses to map. Returns false iff the file couldn't be mapped.
+bool _hashtable_tsv_map(const char *path, char **data, size_t *length) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    *data = NULL;
+    *length = (size_t) st.st_size;
+
+    if (*length == 0) {
+        close(fd);
+        return true;
+    }
+
+    void *mapping = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) return false;
+
+    madvise(mapping, *length, MADV_SEQUENTIAL);
+    *data = mapping;
+
+    return true;
+}
+
+// Returns size bytes of the arena, allocating a new block if the current one 
+// has no room for them
+char *_hashtable_tsv_alloc(hashtable_tsv *tsv, size_t size) {
+    hashtable_tsv_block *block = tsv->blocks;
+
+    if (!block || block->size - block->used < size) {
+        size_t block_size = size > HASHTABLE_TSV_BLOCK_SIZE ? size : HASHTABLE_TSV_BLOCK_SIZE;
+
+        block = malloc(sizeof(hashtable_tsv_block) + block_size);
+        block->next = tsv->blocks;
+        block->size = block_size;
+        block->used = 0;
+        tsv->blocks = block;
+    }
+
+    char *data = block->data + block->used;
+    block->used += size;
+
+    return data;
+}
+
+// Copies the key and value of the record in [line, end) into the arena, 
+// returning false iff the line is blank
+bool _hashtable_tsv_parse(hashtable_tsv *tsv, const char *line, const char *end, char **key, char **val) {
+    // Drop the carriage return of CRLF line endings before checking for blank
+    // lines, so that a lone "\r\n" is skipped too
+    if (end > line && end[-1] == '\r') end--;
+    if (end == line) return false;
+
+    const char *tab = memchr(line, '\t', (size_t) (end - line));
+    size_t key_len = (size_t) ((tab ? tab : end) - line);
+    size_t val_len = tab ? (size_t) (end - tab - 1) : 0;
+
+    *key = _hashtable_tsv_alloc(tsv, key_len + val_len + 2);
+    memcpy(*key, line, key_len);
+    (*key)[key_len] = '\0';
+
+    *val = *key + key_len + 1;
+    if (tab) memcpy(*val, tab + 1, val_len);
+    (*val)[val_len] = '\0';
+
+    return true;
+}
+
+// Hashes a chunk of parsed records and then puts them in the hashtable, 
+// returning how many of them added a new key
+uint32_t _hashtable_tsv_add_chunk(hashtable *table, char **keys, char **vals, uint32_t n) {
+    unsigned long hashes[HASHTABLE_TSV_CHUNK];
+    uint32_t added = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        hashes[i] = hashtable_hash(keys[i]);
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        bool is_inserted;
+        void **slot = hashtable_find_or_insert_with_hash(table, keys[i], vals[i], hashes[i], &is_inserted);
+
+        if (!slot) continue;
+
+        // A later record for a key replaces the value of an earlier one
+        if (is_inserted) {
+            added++;
+        } else {
+            *slot = vals[i];
+        }
+    }
+
+    return added;
+}
+
+hashtable_tsv *hashtable_tsv_load(hashtable *table, const char *path, uint32_t *loaded) {
+    if (loaded) *loaded = 0;
+
+    if (!table || !path) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to load a TSV file with a null argument", "Returning null");
+        return NULL;
+    }
+
+    // The values are strings of any length, which an inline hashtable would copy
+    // a fixed number of bytes of
+    if (hashtable_get_value_size(table) != 0) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to load a TSV file into an inline hashtable", "Returning null");
+        return NULL;
+    }
+
+    char *data;
+    size_t length;
+
+    if (!_hashtable_tsv_map(path, &data, &length)) {
+        err_init_and_handle(AERR_FAILURE, WARNING, __func__, "Failed to map the TSV file", "Returning null");
+        return NULL;
+    }
+
+    hashtable_tsv *tsv = calloc(1, sizeof(hashtable_tsv));
+
+    char *keys[HASHTABLE_TSV_CHUNK];
+    char *vals[HASHTABLE_TSV_CHUNK];
+    uint32_t n = 0;
+    uint32_t added = 0;
+
+    const char *curr = data;
+    const char *end = data + length;
+
+    while (curr < end) {
+        // The last record may have no newline, in which case it ends the file
+        const char *newline = memchr(curr, '\n', (size_t) (end - curr));
+        const char *line_end = newline ? newline : end;
+
+        if (_hashtable_tsv_parse(tsv, curr, line_end, keys + n, vals + n)) n++;
+        curr = line_end + 1;
+
+        if (n == HASHTABLE_TSV_CHUNK) {
+            added += _hashtable_tsv_add_chunk(table, keys, vals, n);
+            n = 0;
+        }
+    }
+
+    added += _hashtable_tsv_add_chunk(table, keys, vals, n);
+
+    // Every key and value now lives in the arena
+    if (data) munmap(data, length);
+
+    if (loaded) *loaded = added;
+
+    return tsv;
+}
+
+void hashtable_tsv_destroy(hashtable_tsv *tsv) {
+    if (!tsv) return;
+
+    while (tsv->blocks) {
+        hashtable_tsv_block *next = tsv->blocks->next;
+        free(tsv->blocks);
+        tsv->blocks = next;
+    }
+
+    free(tsv);
+}
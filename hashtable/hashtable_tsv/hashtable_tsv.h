@@ -0,0 +1,33 @@
+#ifndef HASHTABLE_TSV_H
+#define HASHTABLE_TSV_H
+
+#include "hashtable_tsv_struct.h"
+#include "../hashtable.h"
+
+/* Loads the records of a TSV file into a hashtable. Each line is a key, a tab 
+ * and a value. The key is mapped to a null-terminated string holding the rest 
+ * of the line, or to an empty string if the line had no tab. Blank lines are 
+ * skipped, and if a key is on more than one line, the value on the last wins.
+ * The file is mapped read-only and scanned in place, and each key and value is
+ * copied once into an arena owned by the returned hashtable_tsv, which packs 
+ * them end to end rather than allocating each separately. The mapping itself is
+ * released before returning.
+ *
+ * @param table  The hashtable to add the records to, which must not be inline
+ * @param path   The path of the TSV file to load
+ * @param loaded Set to the number of keys added to the hashtable, if not NULL
+ * @return       A pointer to the hashtable_tsv which owns the loaded keys and 
+ *               values, or NULL if the file couldn't be mapped or the hashtable
+ *               is inline
+ */
+hashtable_tsv *hashtable_tsv_load(hashtable *table, const char *path, uint32_t *loaded);
+
+/* Frees the keys and values loaded from a TSV file, and all other memory that 
+ * its hashtable_tsv occupied. Any keys and values loaded from it are no longer
+ * valid.
+ *
+ * @param tsv The hashtable_tsv to destroy
+ */
+void hashtable_tsv_destroy(hashtable_tsv *tsv);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef HASHTABLE_TSV_STRUCT_H
+#define HASHTABLE_TSV_STRUCT_H
+
+#include <stddef.h>
+
+// The number of records parsed and hashed before they are added to the 
+// hashtable together
+#define HASHTABLE_TSV_CHUNK 1024
+
+// The size of each block of a hashtable_tsv's arena. Records longer than this 
+// get a block of their own.
+#define HASHTABLE_TSV_BLOCK_SIZE (1 << 20)
+
+/* A block of the arena that loaded keys and values are copied into
+ *
+ * @elem next The block allocated before this one, or NULL
+ * @elem size The number of bytes in data
+ * @elem used The number of bytes of data holding keys and values
+ * @elem data The null-terminated keys and values, packed end to end
+ */
+typedef struct hashtable_tsv_block {
+    struct hashtable_tsv_block *next;
+    size_t size;
+    size_t used;
+    char data[];
+} hashtable_tsv_block;
+
+/* A struct owning the keys and values loaded from a TSV file. It must outlive 
+ * every hashtable the file was loaded into.
+ *
+ * @elem blocks The blocks of the arena, most recently allocated first
+ */
+typedef struct hashtable_tsv {
+    hashtable_tsv_block *blocks;
+} hashtable_tsv;
+
+#endif
@@ -0,0 +1,262 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shm_hashtable.h"
+#include "../hashtable.h"
+#include "../../crash_test/err/err.h"
+
+uint64_t _shm_hashtable_align(uint64_t offset) {
+    return (offset + SHM_HASHTABLE_ALIGN - 1) & ~(uint64_t) (SHM_HASHTABLE_ALIGN - 1);
+}
+
+shm_hashtable_entry *_shm_hashtable_get_entry(shm_hashtable *table, uint64_t offset) {
+    if (offset == 0) return NULL;
+    return (shm_hashtable_entry *) ((char *) table->header + offset);
+}
+
+// Returns the value of an entry, which is aligned after its key
+void *_shm_hashtable_get_value(shm_hashtable_entry *entry) {
+    return entry->data + _shm_hashtable_align((uint64_t) entry->key_len + 1);
+}
+
+// Loads a link, seeing the whole of the entry it points to once it is linked in
+uint64_t _shm_hashtable_load_link(uint64_t *link) {
+    return __atomic_load_n(link, __ATOMIC_ACQUIRE);
+}
+
+void _shm_hashtable_store_link(uint64_t *link, uint64_t offset) {
+    __atomic_store_n(link, offset, __ATOMIC_RELEASE);
+}
+
+// Maps a whole shared-memory object into this process, returning a handle on it
+shm_hashtable *_shm_hashtable_map(int fd, uint64_t region_size, bool is_writer) {
+    int prot = is_writer ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *region = mmap(NULL, region_size, prot, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (region == MAP_FAILED) return NULL;
+
+    shm_hashtable *table = malloc(sizeof(shm_hashtable));
+    table->header = region;
+    table->buckets = (uint64_t *) ((char *) region + _shm_hashtable_align(sizeof(shm_hashtable_header)));
+    table->region_size = region_size;
+    table->is_writer = is_writer;
+
+    return table;
+}
+
+// Checks that a header describes a hashtable which fits in the region_size bytes
+// mapped, so that none of its offsets lead outside the mapping
+bool _shm_hashtable_is_valid(shm_hashtable_header *header, uint64_t region_size) {
+    uint64_t arena_begin = _shm_hashtable_align(sizeof(shm_hashtable_header)) + (uint64_t) header->capacity * sizeof(uint64_t);
+
+    return header->capacity > 0 &&
+        header->arena_begin == arena_begin &&
+        header->region_size <= region_size &&
+        arena_begin < header->region_size;
+}
+
+shm_hashtable *shm_hashtable_create(const char *name, uint32_t capacity, uint64_t region_size) {
+    if (!name || capacity == 0) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to create a shared hashtable with no name or capacity", "Returning null");
+        return NULL;
+    }
+
+    uint64_t arena_begin = _shm_hashtable_align(sizeof(shm_hashtable_header)) + (uint64_t) capacity * sizeof(uint64_t);
+    if (region_size <= arena_begin) {
+        err_init_and_handle(AERR_MAX_CAPACITY, WARNING, __func__, "Attempted to create a shared hashtable too small for its buckets", "Returning null");
+        return NULL;
+    }
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t) region_size) != 0) {
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(name);
+        }
+        err_init_and_handle(AERR_FAILURE, WARNING, __func__, "Failed to create the shared memory for a hashtable", "Returning null");
+        return NULL;
+    }
+
+    shm_hashtable *table = _shm_hashtable_map(fd, region_size, true);
+    if (!table) {
+        shm_unlink(name);
+        err_init_and_handle(AERR_FAILURE, WARNING, __func__, "Failed to map the shared memory for a hashtable", "Returning null");
+        return NULL;
+    }
+
+    // ftruncate zero-fills the region, so every bucket starts empty
+    shm_hashtable_header *header = table->header;
+    header->region_size = region_size;
+    header->capacity = capacity;
+    header->size = 0;
+    header->arena_begin = arena_begin;
+    header->arena_used = arena_begin;
+
+    // Readers check the magic last, so publish it once the rest is in place
+    __atomic_store_n(&header->magic, SHM_HASHTABLE_MAGIC, __ATOMIC_RELEASE);
+
+    return table;
+}
+
+shm_hashtable *shm_hashtable_open(const char *name) {
+    if (!name) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to open a shared hashtable with a null name", "Returning null");
+        return NULL;
+    }
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(shm_hashtable_header)) {
+        if (fd >= 0) close(fd);
+        err_init_and_handle(AERR_FAILURE, WARNING, __func__, "Failed to open the shared memory of a hashtable", "Returning null");
+        return NULL;
+    }
+
+    shm_hashtable *table = _shm_hashtable_map(fd, (uint64_t) st.st_size, false);
+    if (!table) {
+        err_init_and_handle(AERR_FAILURE, WARNING, __func__, "Failed to map the shared memory of a hashtable", "Returning null");
+        return NULL;
+    }
+
+    if (__atomic_load_n(&table->header->magic, __ATOMIC_ACQUIRE) != SHM_HASHTABLE_MAGIC) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to open shared memory which doesn't hold a hashtable", "Returning null");
+        shm_hashtable_close(table);
+        return NULL;
+    }
+
+    if (!_shm_hashtable_is_valid(table->header, (uint64_t) st.st_size)) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, __func__, "Attempted to open a shared hashtable whose header doesn't fit its shared memory", "Returning null");
+        shm_hashtable_close(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+void shm_hashtable_close(shm_hashtable *table) {
+    if (!table) return;
+
+    munmap(table->header, table->region_size);
+    free(table);
+}
+
+bool shm_hashtable_unlink(const char *name) {
+    return name && shm_unlink(name) == 0;
+}
+
+uint32_t shm_hashtable_get_size(shm_hashtable *table) {
+    if (!table) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to get the size of a null shared hashtable", "Returning 0");
+        return 0;
+    }
+
+    return __atomic_load_n(&table->header->size, __ATOMIC_RELAXED);
+}
+
+// Finds the entry for a key, and the link pointing to it. Readers may call this
+// while the writer changes the links: each link is stored atomically, only 
+// once the entry it points to is complete, so a walk always follows a valid 
+// chain, and sees each bucket either before or after a change.
+shm_hashtable_entry *_shm_hashtable_find(shm_hashtable *table, char *key, unsigned long hash, uint64_t **link) {
+    *link = table->buckets + hash % table->header->capacity;
+
+    for (shm_hashtable_entry *curr = _shm_hashtable_get_entry(table, _shm_hashtable_load_link(*link)); curr; curr = _shm_hashtable_get_entry(table, _shm_hashtable_load_link(*link))) {
+        if (curr->hash == hash && strcmp(curr->data, key) == 0) return curr;
+        *link = &curr->next;
+    }
+
+    return NULL;
+}
+
+const void *shm_hashtable_get(shm_hashtable *table, char *key, uint32_t *value_len) {
+    if (!table || !key) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to look up a null key or shared hashtable", "Returning null");
+        return NULL;
+    }
+
+    uint64_t *link;
+    shm_hashtable_entry *entry = _shm_hashtable_find(table, key, hashtable_hash(key), &link);
+
+    if (!entry) return NULL;
+
+    // An entry's value never changes once it is linked in, so it can be read 
+    // however long the caller holds on to it
+    if (value_len) *value_len = entry->value_len;
+    return _shm_hashtable_get_value(entry);
+}
+
+bool _shm_hashtable_can_write(shm_hashtable *table, char *key, const char *func) {
+    if (!table || !key) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, func, "Attempted to write a null key or shared hashtable", "Returning false");
+        return false;
+    }
+
+    if (!table->is_writer) {
+        err_init_and_handle(AERR_INVALID_INPUT, WARNING, func, "Attempted to write to a shared hashtable opened for reading", "Returning false");
+        return false;
+    }
+
+    return true;
+}
+
+bool shm_hashtable_put(shm_hashtable *table, char *key, const void *value, uint32_t value_len) {
+    if (!_shm_hashtable_can_write(table, key, __func__)) return false;
+
+    shm_hashtable_header *header = table->header;
+    size_t key_len = strlen(key);
+    uint64_t entry_size = _shm_hashtable_align(sizeof(shm_hashtable_entry) + _shm_hashtable_align(key_len + 1) + value_len);
+
+    if (key_len > UINT32_MAX || header->arena_used + entry_size > header->region_size) {
+        err_init_and_handle(AERR_MAX_CAPACITY, WARNING, __func__, "Attempted to put into a full shared hashtable", "Aborting put; Returning false");
+        return false;
+    }
+
+    // Write the whole entry before linking it in, so that readers never see a 
+    // partial one
+    unsigned long hash = hashtable_hash(key);
+    uint64_t offset = header->arena_used;
+    shm_hashtable_entry *entry = _shm_hashtable_get_entry(table, offset);
+
+    entry->hash = hash;
+    entry->key_len = (uint32_t) key_len;
+    entry->value_len = value_len;
+    memcpy(entry->data, key, key_len + 1);
+    if (value_len > 0) memcpy(_shm_hashtable_get_value(entry), value, value_len);
+
+    header->arena_used += entry_size;
+
+    uint64_t *link;
+    shm_hashtable_entry *old = _shm_hashtable_find(table, key, hash, &link);
+
+    // Replace the old entry in its place in the chain, or push onto the bucket.
+    // Either way a single store of the link publishes the whole entry.
+    if (old) {
+        entry->next = old->next;
+    } else {
+        link = table->buckets + hash % header->capacity;
+        entry->next = *link;
+        __atomic_store_n(&header->size, header->size + 1, __ATOMIC_RELAXED);
+    }
+    _shm_hashtable_store_link(link, offset);
+
+    return true;
+}
+
+bool shm_hashtable_remove(shm_hashtable *table, char *key) {
+    if (!_shm_hashtable_can_write(table, key, __func__)) return false;
+
+    uint64_t *link;
+    shm_hashtable_entry *entry = _shm_hashtable_find(table, key, hashtable_hash(key), &link);
+    if (!entry) return false;
+
+    _shm_hashtable_store_link(link, entry->next);
+    __atomic_store_n(&table->header->size, table->header->size - 1, __ATOMIC_RELAXED);
+
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef SHM_HASHTABLE_H
+#define SHM_HASHTABLE_H
+
+#include "shm_hashtable_struct.h"
+
+/* Creates a hashtable in a new POSIX shared-memory object, so that other 
+ * processes can open and read it without a copy of their own. The process that
+ * creates it is its only writer. The buckets are fixed at creation, and entries
+ * are appended to an arena which is never compacted, so the region must be 
+ * sized for every put over its lifetime.
+ *
+ * @param name        The name of the shared-memory object, as for shm_open
+ * @param capacity    The number of buckets
+ * @param region_size The size of the whole region in bytes
+ * @return            A writable handle on the hashtable, or NULL if the region
+ *                    couldn't be created (including if it already exists)
+ */
+shm_hashtable *shm_hashtable_create(const char *name, uint32_t capacity, uint64_t region_size);
+
+/* Opens a hashtable created by shm_hashtable_create in another process, for 
+ * reading only
+ *
+ * @param name The name of the shared-memory object, as for shm_open
+ * @return     A read-only handle on the hashtable, or NULL if it couldn't be 
+ *             opened
+ */
+shm_hashtable *shm_hashtable_open(const char *name);
+
+/* Unmaps a hashtable from this process, and frees its handle. The region itself
+ * lives on until it is unlinked and every process has closed it.
+ *
+ * @param table The handle to close
+ */
+void shm_hashtable_close(shm_hashtable *table);
+
+/* Removes the name of a shared-memory hashtable, so that no more processes can
+ * open it
+ *
+ * @param name The name of the shared-memory object
+ * @return     True iff the name was removed
+ */
+bool shm_hashtable_unlink(const char *name);
+
+/* Returns the number of entries in a shared-memory hashtable
+ *
+ * @param table The hashtable to get the size of
+ * @return      The number of entries in the hashtable
+ */
+uint32_t shm_hashtable_get_size(shm_hashtable *table);
+
+/* Looks up a key without copying its value. Readers take no locks, so they 
+ * never block the writer, and a writer which dies mid-update can't block them.
+ *
+ * @param table     The hashtable in which to look up the key
+ * @param key       The key to look up
+ * @param value_len Set to the length of the value, if not NULL
+ * @return          A pointer to the value within the region, aligned to 
+ *                  SHM_HASHTABLE_ALIGN, which remains valid until the hashtable
+ *                  is closed, or NULL if the key is 
+ *                  not in the hashtable
+ */
+const void *shm_hashtable_get(shm_hashtable *table, char *key, uint32_t *value_len);
+
+/* Maps a key to a copy of a value, replacing any value the key had. Only the 
+ * process which created the hashtable may put to it.
+ *
+ * @param table     The hashtable to put the entry into
+ * @param key       The key of the entry
+ * @param value     The bytes of the value, which are copied into the region
+ * @param value_len The length of the value in bytes
+ * @return          True iff the entry was put into the hashtable. Else false, 
+ *                  including if the arena is full.
+ */
+bool shm_hashtable_put(shm_hashtable *table, char *key, const void *value, uint32_t value_len);
+
+/* Removes a key from a shared-memory hashtable. The space of its entry is not 
+ * reused, since readers may still hold pointers into it.
+ *
+ * @param table The hashtable to remove the key from
+ * @param key   The key to remove
+ * @return      True iff the key was removed from the hashtable
+ */
+bool shm_hashtable_remove(shm_hashtable *table, char *key);
+
+#endif
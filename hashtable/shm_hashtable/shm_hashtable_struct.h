@@ -0,0 +1,68 @@
+#ifndef SHM_HASHTABLE_STRUCT_H
+#define SHM_HASHTABLE_STRUCT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Identifies a region as holding an shm_hashtable, of this layout
+#define SHM_HASHTABLE_MAGIC 0x32485348544d4853ULL
+
+// Entries are aligned so that their offsets can be loaded and stored atomically
+#define SHM_HASHTABLE_ALIGN 8
+
+/* The header at the start of a shared-memory region. Every reference within the
+ * region is an offset from the start of the region, since each process maps it 
+ * at a different address. Offset 0 is the header, so it doubles as null.
+ *
+ * @elem magic       SHM_HASHTABLE_MAGIC, once the region has been initialized
+ * @elem region_size The size of the whole region in bytes
+ * @elem capacity    The number of buckets, which is fixed at creation
+ * @elem size        The number of entries in the hashtable
+ * @elem arena_begin The offset of the first byte of the entry arena
+ * @elem arena_used  The offset of the first free byte of the entry arena
+ */
+typedef struct shm_hashtable_header {
+    uint64_t magic;
+    uint64_t region_size;
+    uint32_t capacity;
+    uint32_t size;
+    uint64_t arena_begin;
+    uint64_t arena_used;
+} shm_hashtable_header;
+
+/* An entry in the arena. Entries are never changed once linked in except for 
+ * next, nor reused once unlinked, so a reader may keep pointers into one.
+ *
+ * @elem next      The offset of the next entry in the bucket, or 0
+ * @elem hash      The hash of the key
+ * @elem key_len   The length of the key, excluding its null terminator
+ * @elem value_len The length of the value in bytes
+ * @elem data      The null-terminated key, followed by the value at the next 
+ *                 SHM_HASHTABLE_ALIGN boundary
+ */
+typedef struct shm_hashtable_entry {
+    uint64_t next;
+    uint64_t hash;
+    uint32_t key_len;
+    uint32_t value_len;
+    char data[];
+} shm_hashtable_entry;
+
+/* A process's handle on a hashtable in a shared-memory region
+ *
+ * @elem header      The header of the mapped region
+ * @elem buckets     The offsets of the head entry of each bucket, or 0
+ * @elem region_size The length of this process's mapping of the region. Kept 
+ *                   out of the region, whose header another process may have 
+ *                   left in any state.
+ * @elem is_writer   True iff this handle created the region, and so may write
+ */
+typedef struct shm_hashtable {
+    shm_hashtable_header *header;
+    uint64_t *buckets;
+    uint64_t region_size;
+    bool is_writer;
+} shm_hashtable;
+
+#endif
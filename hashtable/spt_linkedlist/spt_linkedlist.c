@@ -1,7 +1,8 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "spt_linkedlist_struct.h"
+#include "spt_linkedlist.h"
+#include "../../crash_test/err/err.h"
 
 // Note that checks on the nullity of the head are irrelevant in this code, but 
 // act as a safety mechanism for later alterations
@@ -35,10 +36,18 @@ spt_linkedlist *spt_linkedlist_init(spt_linkedlist_node *node) {
     return list;
 }
 
+void spt_linkedlist_clear(spt_linkedlist *list) {
+    if (!list) return;
+
+    spt_linkedlist_node_destroy_all(spt_linkedlist_get_head(list));
+
+    list->head = NULL;
+    list->size = 0;
+}
+
 void spt_linkedlist_destroy(spt_linkedlist *list) {
-    // spt_linkedlist_get_head(list) acts as a NULL check as well
-    spt_linkedlist_node *head = spt_linkedlist_get_head(list);
-    spt_linkedlist_node_destroy_all(head);
+    // spt_linkedlist_clear(list) acts as a NULL check as well
+    spt_linkedlist_clear(list);
 
     free(list);
 }
@@ -84,9 +93,9 @@ bool spt_linkedlist_add(spt_linkedlist *list, spt_linkedlist_node *node) {
     }
 
     // Checks that list != NULL and HEAD == NULL
+    // spt_linkedlist_set_head recalculates the size, so we don't increment it
     if (!spt_linkedlist_get_head(list)) {
         spt_linkedlist_set_head(list, node);
-        list->size++;
 
         return true;
     }
@@ -141,7 +150,9 @@ spt_linkedlist_node *spt_linkedlist_pop(spt_linkedlist *list) {
         return NULL;
     }
 
-    spt_linkedlist_set_head(list, spt_linkedlist_node_get_next(fmr_head));
+    // Set the head directly: spt_linkedlist_set_head would recount the whole
+    // list, making a pop O(n)
+    list->head = spt_linkedlist_node_get_next(fmr_head);
     list->size--;
 
     // The freeing of this node must be handled (properly -- not to delete the
@@ -168,26 +179,19 @@ bool spt_linkedlist_remove_node_by_str(spt_linkedlist *list, char *str) {
         return false;
     }
 
-    spt_linkedlist_node *curr = spt_linkedlist_node_get_next(curr);
+    // Head case
+    if (str_ptr_tuple_strcmp(spt_linkedlist_node_get_tuple(head), str)) {
+        list->head = spt_linkedlist_node_get_next(head);
+        list->size--;
 
-    // Singleton list case
-    if (!curr) {
-        str_ptr_tuple *head_tuple = spt_linkedlist_node_get_tuple(head);
-
-        // Destroy iff the two strings match
-        if (str_ptr_tuple_strcmp(head_tuple, str)) {
-            spt_linkedlist_set_head(list, NULL);
-
-            spt_linkedlist_node_destroy(head);
-
-            return true;
-        }
+        spt_linkedlist_node_destroy(head);
 
-        return false;
+        return true;
     }
 
     // We use this alias for readability in our code
     spt_linkedlist_node *prev = head;
+    spt_linkedlist_node *curr = spt_linkedlist_node_get_next(head);
 
     while (curr) {
         str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(curr);
@@ -196,6 +200,8 @@ bool spt_linkedlist_remove_node_by_str(spt_linkedlist *list, char *str) {
 
         if (str_ptr_tuple_strcmp(tuple, str)) {
             spt_linkedlist_node_set_next(prev, next);
+            list->size--;
+
             spt_linkedlist_node_destroy(curr);
             return true;
         }
@@ -207,13 +213,48 @@ bool spt_linkedlist_remove_node_by_str(spt_linkedlist *list, char *str) {
     return false;
 }
 
-str_ptr_tuple *spt_linkedlist_find_str(spt_linkedlist *list, char *str) {
+bool spt_linkedlist_unlink_node(spt_linkedlist *list, spt_linkedlist_node *prev, spt_linkedlist_node *node) {
+    if (!list || !node) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted an invalid unlink from an spt_linkedlist", "Returning false");
+        return false;
+    }
+
+    spt_linkedlist_node *next = spt_linkedlist_node_get_next(node);
+
+    if (prev) {
+        spt_linkedlist_node_set_next(prev, next);
+    } else {
+        list->head = next;
+    }
+
+    spt_linkedlist_node_set_next(node, NULL);
+    list->size--;
+
+    return true;
+}
+
+spt_linkedlist_node *spt_linkedlist_get_node_by_str(spt_linkedlist *list, char *str) {
+    spt_linkedlist_node *curr = spt_linkedlist_get_head(list);
+
+    while (curr) {
+        if (str_ptr_tuple_strcmp(spt_linkedlist_node_get_tuple(curr), str)) {
+            return curr;
+        }
+
+        curr = spt_linkedlist_node_get_next(curr);
+    }
+
+    return NULL;
+}
+
+spt_linkedlist_node *spt_linkedlist_get_node_by_hashed_str(spt_linkedlist *list, unsigned long hash, char *str) {
     spt_linkedlist_node *curr = spt_linkedlist_get_head(list);
 
     while (curr) {
         str_ptr_tuple *tuple = spt_linkedlist_node_get_tuple(curr);
-        if (str_ptr_tuple_strcmp(tuple, str)) {
-            return tuple;
+
+        if (str_ptr_tuple_get_hash(tuple) == hash && str_ptr_tuple_strcmp(tuple, str)) {
+            return curr;
         }
 
         curr = spt_linkedlist_node_get_next(curr);
@@ -221,3 +262,8 @@ str_ptr_tuple *spt_linkedlist_find_str(spt_linkedlist *list, char *str) {
 
     return NULL;
 }
+
+str_ptr_tuple *spt_linkedlist_find_str(spt_linkedlist *list, char *str) {
+    // spt_linkedlist_node_get_tuple returns NULL if there was no match
+    return spt_linkedlist_node_get_tuple(spt_linkedlist_get_node_by_str(list, str));
+}
@@ -18,6 +18,13 @@ spt_linkedlist *spt_linkedlist_init(spt_linkedlist_node *node);
  */
 void spt_linkedlist_destroy(spt_linkedlist *list);
 
+/* Destroys all nodes in the spt_linkedlist, leaving it empty. Unlike 
+ * spt_linkedlist_destroy, this does not free the spt_linkedlist itself.
+ *
+ * @param list The spt_linkedlist to be emptied.
+ */
+void spt_linkedlist_clear(spt_linkedlist *list);
+
 /* Returns the number of nodes in the specified spt_linkedlist
  *
  * @pre        The linkedlist terminates
@@ -50,6 +57,15 @@ spt_linkedlist_node *spt_linkedlist_get_last(spt_linkedlist *list);
  */
 bool spt_linkedlist_remove_node_by_str(spt_linkedlist *list, char *str);
 
+/* Unlinks a node from the spt_linkedlist without destroying it
+ *
+ * @param list The spt_linkedlist to unlink the node from
+ * @param prev The node before node in list, or NULL if node is the head
+ * @param node The node to unlink
+ * @return     True iff the node was successfully unlinked
+ */
+bool spt_linkedlist_unlink_node(spt_linkedlist *list, spt_linkedlist_node *prev, spt_linkedlist_node *node);
+
 /* Sets the head of the linkedlist to the linkedlist's head's next, and returns
  * the former head node.
  *
@@ -62,11 +78,22 @@ spt_linkedlist_node *spt_linkedlist_pop(spt_linkedlist *list);
  *
  * @param list The linkedlist to obtain the node from
  * @param str  The str of the node we are trying to find
- * @return     The str_ptr_tuple with string equal to str. If there is no match
- *             then returns NULL
+ * @return     The node whose tuple has a string equal to str. If there is no 
+ *             match then returns NULL
  */
 spt_linkedlist_node *spt_linkedlist_get_node_by_str(spt_linkedlist *list, char *str);
 
+/* Returns the node within the linkedlist that holds the specified str, using 
+ * the hashes cached in the tuples to skip most string comparisons
+ *
+ * @param list The linkedlist to obtain the node from
+ * @param hash The hash of str
+ * @param str  The str of the node we are trying to find
+ * @return     The node whose tuple has a string equal to str. If there is no 
+ *             match then returns NULL
+ */
+spt_linkedlist_node *spt_linkedlist_get_node_by_hashed_str(spt_linkedlist *list, unsigned long hash, char *str);
+
 /* Returns the node at the index within the specified spt_linkedlist
  *
  * @param list  The spt_linkedlist which provides ordering to its nodes
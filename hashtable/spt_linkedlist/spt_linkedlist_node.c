@@ -1,19 +1,53 @@
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "spt_linkedlist_node.h"
+#include "../../crash_test/err/err.h"
 
-spt_linkedlist_node *spt_linkedlist_node_init(str_ptr_tuple *tuple) {
-    spt_linkedlist_node *node = malloc(sizeof(spt_linkedlist_node));
+// Allocates a node with room for ptr_size bytes of inline value in place of its
+// tuple's ptr, rounded up to whole cache lines
+spt_linkedlist_node *_spt_linkedlist_node_alloc(uint32_t ptr_size) {
+    size_t size = offsetof(spt_linkedlist_node, tuple.ptr) + (ptr_size > sizeof(void *) ? ptr_size : sizeof(void *));
+    size = (size + SPT_LINKEDLIST_NODE_ALIGN - 1) & ~(size_t) (SPT_LINKEDLIST_NODE_ALIGN - 1);
+
+    spt_linkedlist_node *node = aligned_alloc(SPT_LINKEDLIST_NODE_ALIGN, size);
 
-    node->tuple = tuple;
     node->next = NULL;
+    node->timer = NULL;
+    node->is_referenced = false;
+
+    return node;
+}
+
+spt_linkedlist_node *spt_linkedlist_node_init(str_ptr_tuple *tuple) {
+    spt_linkedlist_node *node = _spt_linkedlist_node_alloc(0);
+
+    node->tuple = *tuple;
+    str_ptr_tuple_destroy(tuple);
+
+    return node;
+}
+
+spt_linkedlist_node *spt_linkedlist_node_init_inline(char *str, void *ptr, uint32_t ptr_size) {
+    spt_linkedlist_node *node = _spt_linkedlist_node_alloc(ptr_size);
+
+    node->tuple.str = str;
+    node->tuple.hash = 0;
+
+    if (ptr_size == 0) {
+        node->tuple.ptr = ptr;
+    } else if (ptr) {
+        memcpy(&(node->tuple.ptr), ptr, ptr_size);
+    } else {
+        memset(&(node->tuple.ptr), 0, ptr_size);
+    }
 
     return node;
 }
 
 void spt_linkedlist_node_destroy(spt_linkedlist_node *node) {
-    // Using spt_linkedlist_node_get_tuple as a NULL check
-    str_ptr_tuple_destroy(spt_linkedlist_node_get_tuple(node));
+    // The tuple is freed along with the node
     free(node);
 }
 
@@ -40,7 +74,7 @@ spt_linkedlist_node *spt_linkedlist_node_get_next(spt_linkedlist_node *node) {
 
 void *spt_linkedlist_node_get_tuple(spt_linkedlist_node *node) {
     if (!node) return NULL;
-    return node->tuple;
+    return &(node->tuple);
 }
 
 bool spt_linkedlist_node_has_next(spt_linkedlist_node *node) {
@@ -62,6 +96,7 @@ bool spt_linkedlist_node_set_tuple(spt_linkedlist_node *node, str_ptr_tuple *tup
         err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to set tuple in a null spt_linkedlist_node", "Returning false");
         return false;
     }
-    node->tuple = tuple;
+    node->tuple = *tuple;
+    str_ptr_tuple_destroy(tuple);
     return true;
 }
@@ -2,18 +2,13 @@
 #define SPT_LINKEDLIST_NODE_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
-#include "str_ptr_tuple/str_ptr_tuple_struct.h"
+#include "str_ptr_tuple/str_ptr_tuple.h"
 #include "spt_linkedlist_node_struct.h"
 
-typedef struct spt_linkedlist_node spt_linkedlist_node;
-
-struct spt_linkedlist_node {
-    spt_linkedlist_node *next;
-    str_ptr_tuple *tuple;
-};
-
-/* Creates a new spt_linkedlist_node and returns a pointer to it in memory. Does 
+/* Creates a new spt_linkedlist_node and returns a pointer to it in memory. The
+ * node holds a copy of the tuple, and the tuple passed in is destroyed. Does 
  * not set next
  *
  * @param value The value to set within the linkedlist_node
@@ -21,6 +16,20 @@ struct spt_linkedlist_node {
  */
 spt_linkedlist_node *spt_linkedlist_node_init(str_ptr_tuple *tuple);
 
+/* Creates a new spt_linkedlist_node together with its tuple in a single block of
+ * memory, and returns a pointer to it. If ptr_size is non-zero, the ptr_size 
+ * bytes at ptr are copied into the block in place of the tuple's ptr, starting 
+ * at str_ptr_tuple_get_ptr_slot of the tuple. Does not set next
+ *
+ * @param str      The str of the node's tuple
+ * @param ptr      The ptr of the node's tuple, or the value to copy if ptr_size
+ *                 is non-zero. If NULL, a copied value is zero-filled.
+ * @param ptr_size The number of bytes of value to store inline, or zero to 
+ *                 store ptr itself
+ * @return         A pointer to the locaction of the created spt_linkedlist_node
+ */
+spt_linkedlist_node *spt_linkedlist_node_init_inline(char *str, void *ptr, uint32_t ptr_size);
+
 /* Clears the memory space occupied by the input linkedlist_node and its tuple
  * 
  * @param node A pointer to the location of the node to be destroyed
@@ -65,7 +74,8 @@ bool spt_linkedlist_node_has_next(spt_linkedlist_node *node);
 bool spt_linkedlist_node_set_next(spt_linkedlist_node *curr, spt_linkedlist_node *new_next);
 
 /* Sets the value of a specified linkedlist_node to the value specified as a 
- * parameter
+ * parameter. The node holds a copy of the tuple, and the tuple passed in is 
+ * destroyed.
  *
  * @param node  A pointer to the node to set the tuple of
  * @param value A pointer to the tuple to set the node's tuple to
@@ -1,13 +1,26 @@
-#ifndef SPT_LINKEDLIST_NODE_H
-#define SPT_LINKEDLIST_NODE_H
+#ifndef SPT_LINKEDLIST_NODE_STRUCT_H
+#define SPT_LINKEDLIST_NODE_STRUCT_H
 
-#include "str_ptr_tuple/str_ptr_tuple.h"
+#include <stdbool.h>
+
+#include "str_ptr_tuple/str_ptr_tuple_struct.h"
+
+// Nodes are allocated on cache line boundaries, so that a node whose tuple and
+// inline value fit in one line is fetched with a single miss
+#define SPT_LINKEDLIST_NODE_ALIGN 64
 
 typedef struct spt_linkedlist_node spt_linkedlist_node;
 
-typedef struct spt_linkedlist_node {
+// The expiry timer of a node, owned by the hashtable the node is in
+struct timing_wheel_timer;
+
+// The tuple is held by value and last, so that an inline value follows on 
+// from it in the same allocation, 40 bytes into the node
+struct spt_linkedlist_node {
     spt_linkedlist_node *next;
-    str_ptr_tuple *tuple;
-} spt_linkedlist_node;
+    struct timing_wheel_timer *timer;
+    bool is_referenced;
+    str_ptr_tuple tuple;
+};
 
 #endif 
@@ -9,6 +9,7 @@ str_ptr_tuple *str_ptr_tuple_init(char *str, void *ptr) {
 
     tuple->str = str;
     tuple->ptr = ptr;
+    tuple->hash = 0;
 
     return tuple;
 }
@@ -29,6 +30,28 @@ void *str_ptr_tuple_get_ptr(str_ptr_tuple *tuple) {
     return tuple->ptr;
 }
 
+void *str_ptr_tuple_get_ptr_slot(str_ptr_tuple *tuple) {
+    if (!tuple) return NULL;
+
+    return &(tuple->ptr);
+}
+
+unsigned long str_ptr_tuple_get_hash(str_ptr_tuple *tuple) {
+    if (!tuple) return 0;
+
+    return tuple->hash;
+}
+
+bool str_ptr_tuple_set_hash(str_ptr_tuple *tuple, unsigned long hash) {
+    if (!tuple) {
+        err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to set hash in a null str_ptr_tuple", "Returning false");
+        return false;
+    }
+
+    tuple->hash = hash;
+    return true;
+}
+
 bool str_ptr_tuple_set_str(str_ptr_tuple *tuple, char *str) {
     if (!tuple) {
         err_init_and_handle(AERR_NULL_PTR, WARNING, __func__, "Attempted to set str in a null str_ptr_tuple", "Returning false");
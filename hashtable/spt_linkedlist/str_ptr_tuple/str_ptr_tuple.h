@@ -32,6 +32,30 @@ char *str_ptr_tuple_get_str(str_ptr_tuple *tuple);
  */ 
 void *str_ptr_tuple_get_ptr(str_ptr_tuple *tuple);
 
+/* Returns the address of the ptr of the specified str_ptr_tuple. For a tuple 
+ * which holds its value inline, this is the address of the value itself.
+ *
+ * @param str_ptr_tuple The str_ptr_tuple to return the ptr slot of
+ * @return              The address of the ptr of the tuple param
+ */ 
+void *str_ptr_tuple_get_ptr_slot(str_ptr_tuple *tuple);
+
+/* Returns the hash of the str cached in the specified str_ptr_tuple
+ *
+ * @param str_ptr_tuple The str_ptr_tuple to return the hash of
+ * @return              The cached hash of the tuple param's str, or 0 if none 
+ *                      has been set
+ */ 
+unsigned long str_ptr_tuple_get_hash(str_ptr_tuple *tuple);
+
+/* Sets the hash of the str cached in a passed-in str_ptr_tuple
+ *
+ * @param str_ptr_tuple The str_ptr_tuple to change the hash of
+ * @param hash          The hash of the str_ptr_tuple's str
+ * @return              True iff the tuple hash was set to hash
+ */
+bool str_ptr_tuple_set_hash(str_ptr_tuple *tuple, unsigned long hash);
+
 /* Sets the ptr of a passed-in str_ptr_tuple to the value specified.
  *
  * @param str_ptr_tuple The str_ptr_tuple to change the str of
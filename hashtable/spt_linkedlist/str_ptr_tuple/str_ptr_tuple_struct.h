@@ -3,8 +3,11 @@
 
 #include <stdbool.h>
 
+// ptr is last so that a value stored inline in the tuple can start in its place
+// and run on past the end of the struct
 typedef struct str_ptr_tuple {
     char *str;
+    unsigned long hash;
     void *ptr;
 } str_ptr_tuple;
 
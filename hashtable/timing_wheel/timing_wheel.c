@@ -0,0 +1,180 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "timing_wheel.h"
+
+#define TIMING_WHEEL_SLOT_MASK (TIMING_WHEEL_SLOTS - 1)
+
+// The number of ticks spanned by one slot of a level
+#define TIMING_WHEEL_SPAN(level) (1ULL << (TIMING_WHEEL_SLOT_BITS * (level)))
+
+void _timing_wheel_link(timing_wheel *wheel, timing_wheel_timer *timer) {
+    uint64_t expires = timer->expires;
+    if (expires < wheel->now) expires = wheel->now;
+
+    // Timers beyond the range of the wheel wait in the furthest slot of the top
+    // level, and are placed again when it is cascaded
+    uint64_t delta = expires - wheel->now;
+    if (delta >= TIMING_WHEEL_SPAN(TIMING_WHEEL_LEVELS)) {
+        delta = TIMING_WHEEL_SPAN(TIMING_WHEEL_LEVELS) - 1;
+        expires = wheel->now + delta;
+    }
+
+    uint8_t level = 0;
+    while (delta >= TIMING_WHEEL_SPAN(level + 1)) {
+        level++;
+    }
+
+    uint8_t index = (expires >> (TIMING_WHEEL_SLOT_BITS * level)) & TIMING_WHEEL_SLOT_MASK;
+    timing_wheel_timer **slot = &wheel->slots[level][index];
+
+    timer->level = level;
+    timer->slot = index;
+    timer->prev = NULL;
+    timer->next = *slot;
+    if (*slot) (*slot)->prev = timer;
+    *slot = timer;
+
+    wheel->level_counts[level]++;
+}
+
+void _timing_wheel_unlink(timing_wheel *wheel, timing_wheel_timer *timer) {
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        wheel->slots[timer->level][timer->slot] = timer->next;
+    }
+    if (timer->next) timer->next->prev = timer->prev;
+
+    wheel->level_counts[timer->level]--;
+}
+
+// Moves every timer in the current slot of a level down into the lower levels
+void _timing_wheel_cascade(timing_wheel *wheel, uint8_t level) {
+    timing_wheel_timer **slot = &wheel->slots[level][(wheel->now >> (TIMING_WHEEL_SLOT_BITS * level)) & TIMING_WHEEL_SLOT_MASK];
+    timing_wheel_timer *curr = *slot;
+
+    *slot = NULL;
+
+    while (curr) {
+        timing_wheel_timer *next = curr->next;
+
+        wheel->level_counts[level]--;
+        _timing_wheel_link(wheel, curr);
+
+        curr = next;
+    }
+}
+
+// Advances the wheel by at least one tick and at most to now, skipping over
+// stretches in which the lower levels are empty
+void _timing_wheel_advance(timing_wheel *wheel, uint64_t now) {
+    // While the levels below level are empty, we can jump straight to the next
+    // slot boundary of level without missing a timer
+    uint8_t level = 0;
+    while (level < TIMING_WHEEL_LEVELS - 1 && wheel->level_counts[level] == 0) {
+        level++;
+    }
+
+    uint64_t span = TIMING_WHEEL_SPAN(level);
+    uint64_t boundary = (wheel->now / span + 1) * span;
+    wheel->now = (boundary < now) ? boundary : now;
+
+    // Cascade from the highest level whose slot boundary we are on downwards, 
+    // so that timers cascaded from above can be cascaded again below
+    int top = 0;
+    while (top < TIMING_WHEEL_LEVELS - 1 && wheel->now % TIMING_WHEEL_SPAN(top + 1) == 0) {
+        top++;
+    }
+
+    for (int i = top; i > 0; i--) {
+        _timing_wheel_cascade(wheel, i);
+    }
+}
+
+timing_wheel *timing_wheel_init(uint64_t now) {
+    timing_wheel *wheel = calloc(1, sizeof(timing_wheel));
+
+    wheel->now = now;
+
+    return wheel;
+}
+
+void timing_wheel_clear(timing_wheel *wheel) {
+    if (!wheel) return;
+
+    for (int level = 0; level < TIMING_WHEEL_LEVELS; level++) {
+        for (int i = 0; i < TIMING_WHEEL_SLOTS; i++) {
+            timing_wheel_timer *curr = wheel->slots[level][i];
+
+            while (curr) {
+                timing_wheel_timer *next = curr->next;
+                free(curr);
+                curr = next;
+            }
+
+            wheel->slots[level][i] = NULL;
+        }
+
+        wheel->level_counts[level] = 0;
+    }
+
+    wheel->count = 0;
+}
+
+void timing_wheel_destroy(timing_wheel *wheel) {
+    timing_wheel_clear(wheel);
+    free(wheel);
+}
+
+timing_wheel_timer *timing_wheel_schedule(timing_wheel *wheel, uint64_t expires, void *owner) {
+    if (!wheel) return NULL;
+
+    timing_wheel_timer *timer = malloc(sizeof(timing_wheel_timer));
+
+    timer->expires = expires;
+    timer->owner = owner;
+
+    _timing_wheel_link(wheel, timer);
+    wheel->count++;
+
+    return timer;
+}
+
+void timing_wheel_cancel(timing_wheel *wheel, timing_wheel_timer *timer) {
+    if (!wheel || !timer) return;
+
+    _timing_wheel_unlink(wheel, timer);
+    wheel->count--;
+
+    free(timer);
+}
+
+void *timing_wheel_expire_next(timing_wheel *wheel, uint64_t now) {
+    if (!wheel) return NULL;
+
+    while (true) {
+        timing_wheel_timer **slot = &wheel->slots[0][wheel->now & TIMING_WHEEL_SLOT_MASK];
+
+        // MID: Every timer in the current slot of level 0 is due
+        if (*slot) {
+            timing_wheel_timer *timer = *slot;
+            void *owner = timer->owner;
+
+            _timing_wheel_unlink(wheel, timer);
+            wheel->count--;
+            free(timer);
+
+            return owner;
+        }
+
+        if (wheel->now >= now) return NULL;
+
+        if (wheel->count == 0) {
+            wheel->now = now;
+            return NULL;
+        }
+
+        _timing_wheel_advance(wheel, now);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include "timing_wheel_struct.h"
+
+/* Creates an empty timing_wheel in memory and returns a pointer to it
+ *
+ * @param now The tick at which the wheel starts
+ * @return    A pointer to the newly created timing_wheel
+ */
+timing_wheel *timing_wheel_init(uint64_t now);
+
+/* Cancels all timers in a timing_wheel, and frees all memory that it occupied
+ *
+ * @param wheel The timing_wheel to destroy
+ */
+void timing_wheel_destroy(timing_wheel *wheel);
+
+/* Cancels all timers in a timing_wheel, leaving it empty
+ *
+ * @param wheel The timing_wheel to clear
+ */
+void timing_wheel_clear(timing_wheel *wheel);
+
+/* Schedules a new timer in a timing_wheel
+ *
+ * @param wheel   The timing_wheel to schedule the timer in
+ * @param expires The tick at which the timer expires. Ticks which have already
+ *                passed expire on the next call to timing_wheel_expire_next.
+ * @param owner   The item the timer belongs to
+ * @return        A pointer to the scheduled timer, or NULL if wheel is NULL
+ */
+timing_wheel_timer *timing_wheel_schedule(timing_wheel *wheel, uint64_t expires, void *owner);
+
+/* Cancels a timer scheduled in a timing_wheel, and frees it
+ *
+ * @param wheel The timing_wheel the timer is scheduled in
+ * @param timer The timer to cancel
+ */
+void timing_wheel_cancel(timing_wheel *wheel, timing_wheel_timer *timer);
+
+/* Advances a timing_wheel towards a tick until a timer expires, then frees that
+ * timer and returns its owner. Calling this until it returns NULL expires every
+ * timer due by now.
+ *
+ * @param wheel The timing_wheel to advance
+ * @param now   The tick to advance the wheel up to
+ * @return      The owner of a timer which has expired, or NULL if no timers 
+ *              are due by now
+ */
+void *timing_wheel_expire_next(timing_wheel *wheel, uint64_t now);
+
+#endif
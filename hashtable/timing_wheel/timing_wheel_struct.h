@@ -0,0 +1,50 @@
+#ifndef TIMING_WHEEL_STRUCT_H
+#define TIMING_WHEEL_STRUCT_H
+
+#include <stdint.h>
+
+// Each level of the wheel has 2^TIMING_WHEEL_SLOT_BITS slots, and each slot of a
+// level spans as many ticks as the whole of the level below. Four levels of 64
+// slots cover 2^24 ticks (over 4 hours of 1ms ticks) before timers are clamped
+// into the top level.
+#define TIMING_WHEEL_LEVELS 4
+#define TIMING_WHEEL_SLOT_BITS 6
+#define TIMING_WHEEL_SLOTS (1 << TIMING_WHEEL_SLOT_BITS)
+
+typedef struct timing_wheel_timer timing_wheel_timer;
+
+/* A timer scheduled in a timing_wheel. Timers in the same slot form a doubly
+ * linked list so that they can be cancelled in O(1).
+ *
+ * @elem prev    The previous timer in the slot, or NULL if this is the first
+ * @elem next    The next timer in the slot, or NULL if this is the last
+ * @elem expires The tick at which the timer expires
+ * @elem level   The level of the slot the timer is in
+ * @elem slot    The index of the slot the timer is in within its level
+ * @elem owner   The item the timer belongs to, returned when it expires
+ */
+struct timing_wheel_timer {
+    timing_wheel_timer *prev;
+    timing_wheel_timer *next;
+    uint64_t expires;
+    uint8_t level;
+    uint8_t slot;
+    void *owner;
+};
+
+/* A hierarchical timing wheel. Expiring N timers costs O(N) plus one cascade
+ * per slot of each level passed, however many timers are scheduled.
+ *
+ * @elem now          The tick up to which the wheel has been advanced
+ * @elem count        The number of timers scheduled in the wheel
+ * @elem level_counts The number of timers scheduled in each level
+ * @elem slots        The first timer in each slot of each level
+ */
+typedef struct timing_wheel {
+    uint64_t now;
+    uint32_t count;
+    uint32_t level_counts[TIMING_WHEEL_LEVELS];
+    timing_wheel_timer *slots[TIMING_WHEEL_LEVELS][TIMING_WHEEL_SLOTS];
+} timing_wheel;
+
+#endif